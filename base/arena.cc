@@ -0,0 +1,102 @@
+#include "base/arena.h"
+
+namespace base {
+
+struct Arena::Block {
+  Block* next;
+  size_t size;
+
+  // Allocate() aligns what it hands out itself.
+  char* data() { return reinterpret_cast<char*>(this + 1); }
+};
+
+namespace {
+
+// Requests at least this large get a block of their own, so they neither
+// waste the rest of the current block nor evict it.
+const size_t kLargeAllocation = Arena::kBlockSize / 4;
+
+}  // namespace
+
+Arena::Arena()
+  : cursor_(NULL)
+  , end_(NULL)
+  , blocks_(NULL)
+  , retired_bytes_(0) {
+}
+
+Arena::~Arena() {
+  FreeBlocks(blocks_);
+}
+
+void Arena::Reset() {
+  if (!blocks_)
+    return;
+  FreeBlocks(blocks_->next);
+  blocks_->next = NULL;
+  // Only a regular block is worth keeping.
+  if (blocks_->size != kBlockSize) {
+    FreeBlocks(blocks_);
+    blocks_ = NULL;
+    cursor_ = end_ = NULL;
+  } else {
+    cursor_ = blocks_->data();
+    end_ = cursor_ + blocks_->size;
+  }
+  retired_bytes_ = 0;
+}
+
+size_t Arena::bytes_allocated() const {
+  if (!blocks_)
+    return retired_bytes_;
+  return retired_bytes_ + (cursor_ - blocks_->data());
+}
+
+void* Arena::AllocateSlow(size_t size, size_t alignment) {
+  size_t needed = size + alignment;
+  if (needed >= kLargeAllocation) {
+    Block* block = NewBlock(needed);
+    // Behind the current block, which keeps serving small requests.
+    if (blocks_) {
+      block->next = blocks_->next;
+      blocks_->next = block;
+    } else {
+      block->next = NULL;
+      blocks_ = block;
+      // Left empty; the next small request starts a block of its own.
+      cursor_ = end_ = block->data();
+    }
+    retired_bytes_ += size;
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(block->data()) + alignment - 1) &
+      ~(alignment - 1);
+    return reinterpret_cast<void*>(aligned);
+  }
+
+  if (blocks_)
+    retired_bytes_ += cursor_ - blocks_->data();
+  Block* block = NewBlock(kBlockSize);
+  block->next = blocks_;
+  blocks_ = block;
+  cursor_ = block->data();
+  end_ = cursor_ + block->size;
+  return Allocate(size, alignment);
+}
+
+// static
+void Arena::FreeBlocks(Block* block) {
+  while (block) {
+    Block* next = block->next;
+    ::operator delete(block);
+    block = next;
+  }
+}
+
+// static
+Arena::Block* Arena::NewBlock(size_t size) {
+  Block* block = static_cast<Block*>(::operator new(sizeof(Block) + size));
+  block->next = NULL;
+  block->size = size;
+  return block;
+}
+
+}  // namespace base
@@ -0,0 +1,117 @@
+#ifndef BASE_ARENA_H_
+#define BASE_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <utility>
+
+namespace base {
+
+// A bump allocator for short-lived scratch objects.  Allocation moves a
+// pointer; nothing is freed individually, everything goes at once in
+// Reset().  Every MessageLoop owns one that is reset after each task, see
+// MessageLoop::task_arena(), so per-task strings, vectors and trees cost no
+// heap traffic:
+//
+//   base::Arena* arena = MessageLoop::current()->task_arena();
+//   std::vector<Token, base::ArenaAllocator<Token> > tokens(
+//     base::ArenaAllocator<Token>(arena));
+//   scoped_ptr<Node, base::ArenaDeleter<Node> > tree(arena->New<Node>(tokens));
+//
+// Not thread-safe.
+class BASE_EXPORT Arena {
+public:
+  static const size_t kBlockSize = 64 * 1024;
+  static const size_t kDefaultAlignment = 16;
+
+  Arena();
+  ~Arena();
+
+  // |alignment| must be a power of two.
+  void* Allocate(size_t size, size_t alignment = kDefaultAlignment) {
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(cursor_) + alignment - 1) &
+      ~(alignment - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(end_);
+    if (aligned <= end && size <= end - aligned && cursor_) {
+      cursor_ = reinterpret_cast<char*>(aligned + size);
+      return reinterpret_cast<void*>(aligned);
+    }
+    return AllocateSlow(size, alignment);
+  }
+
+  // Constructs a T in the arena.  Its destructor only runs if it is owned by
+  // a scoped_ptr with an ArenaDeleter, or called by hand.
+  template <typename T, typename... Args>
+  T* New(Args&&... args) {
+    return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  // Frees everything allocated so far.  The first block is kept for reuse.
+  void Reset();
+
+  // Bytes handed out since the last Reset().
+  size_t bytes_allocated() const;
+
+private:
+  struct Block;
+
+  void* AllocateSlow(size_t size, size_t alignment);
+  static Block* NewBlock(size_t size);
+  static void FreeBlocks(Block* block);
+
+  char* cursor_;
+  char* end_;
+  // The block |cursor_| points into comes first.
+  Block* blocks_;
+  // Bytes handed out from blocks other than the current one.
+  size_t retired_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(Arena);
+};
+
+// An STL allocator drawing from an Arena.  deallocate() does nothing; the
+// memory comes back when the arena is reset, so containers using it must
+// not outlive that.
+template <typename T>
+class ArenaAllocator {
+public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(Arena* arena) : arena_(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T*, size_t) {}
+
+  Arena* arena() const { return arena_; }
+
+private:
+  Arena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+// A scoped_ptr deleter for objects made with Arena::New(): runs the
+// destructor and leaves the memory to the arena.
+template <typename T>
+struct ArenaDeleter {
+  void operator()(T* object) const {
+    object->~T();
+  }
+};
+
+}  // namespace base
+
+#endif
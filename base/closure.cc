@@ -2,10 +2,38 @@
 
 namespace base {
 
+ClosureBase::ClosureBase(const ClosureBase& other)
+  : bind_state_(other.bind_state_)
+  , polymorphic_invoke_(other.polymorphic_invoke_) {
+}
+
+ClosureBase::ClosureBase(ClosureBase&& other)
+  : bind_state_(std::move(other.bind_state_))
+  , polymorphic_invoke_(other.polymorphic_invoke_) {
+  other.polymorphic_invoke_ = NULL;
+}
+
+ClosureBase& ClosureBase::operator=(const ClosureBase& other) {
+  bind_state_ = other.bind_state_;
+  polymorphic_invoke_ = other.polymorphic_invoke_;
+  return *this;
+}
+
+ClosureBase& ClosureBase::operator=(ClosureBase&& other) {
+  bind_state_ = std::move(other.bind_state_);
+  polymorphic_invoke_ = other.polymorphic_invoke_;
+  other.polymorphic_invoke_ = NULL;
+  return *this;
+}
+
 bool ClosureBase::is_null() const {
   return bind_state_.get() == NULL;
 }
 
+bool ClosureBase::IsCancelled() const {
+  return bind_state_.get() && bind_state_->IsCancelled();
+}
+
 void ClosureBase::Reset() {
   polymorphic_invoke_ = NULL;
   bind_state_ = NULL;
@@ -2,9 +2,22 @@
 #define BASE_CLOSURE_H_
 
 #include "base/closure_internal.h"
+#include "base/pool_allocator.h"
 
 namespace base {
 class BindStateBase : public RefCountedThreadSafe<BindStateBase> {
+public:
+  // A bind state is allocated by every Bind() and freed after the task runs,
+  // often on another thread, so keep them off the global heap.
+  static void* operator new(size_t size) {
+    return PoolAllocator::Allocate(size);
+  }
+  static void operator delete(void* block, size_t size) {
+    PoolAllocator::Free(block, size);
+  }
+  // True once running the bound call would do nothing, so queues can drop
+  // it, and free what it holds, before its turn comes.
+  virtual bool IsCancelled() const { return false; }
 protected:
   friend class RefCountedThreadSafe<BindStateBase>;
   virtual ~BindStateBase() {}
@@ -12,7 +25,16 @@ protected:
 
 class BASE_EXPORT ClosureBase {
 public:
+  // Copies share the bind state.  Moves hand it over without touching its
+  // reference count, and leave the source null.
+  ClosureBase(const ClosureBase& other);
+  ClosureBase(ClosureBase&& other);
+  ClosureBase& operator=(const ClosureBase& other);
+  ClosureBase& operator=(ClosureBase&& other);
+
   bool is_null() const;
+  // See BindStateBase::IsCancelled().
+  bool IsCancelled() const;
   void Reset();
 protected:
   typedef void(*InvokeFuncStorage)(void);
@@ -23,138 +45,127 @@ protected:
   InvokeFuncStorage polymorphic_invoke_;
 };
 
-template <typename Runnable, typename BoundArgsType>
+template <typename Runnable, typename RunType, typename BoundArgsType>
 struct BindState;
 
-template <typename Runnable>
-struct BindState<Runnable, void()> : public BindStateBase {
-  typedef IsWeakMethod<false, void> IsWeakCall;
-  typedef Invoker<IsWeakCall::value, BindState, typename Runnable::RunType> InvokerType;
-
-  explicit BindState(const Runnable& runnable)
-    : runnable_(runnable) {}
-  virtual ~BindState() {}
-  Runnable runnable_;
-};
-
-template <typename Runnable, typename P1>
-struct BindState<Runnable, void(P1)> : public BindStateBase {
-  typedef IsWeakMethod<Runnable::IsMethod::value, P1> IsWeakCall;
-  typedef Invoker<IsWeakCall::value, BindState, typename Runnable::RunType> InvokerType;
-  typedef UnwrapTraits<P1> Bound1UnwrapTraits;
-
-  BindState(const Runnable& runnable, const P1& p1)
-    : runnable_(runnable)
-    , p1_(p1) {
-    MaybeRefcount<Runnable::IsMethod::value, P1>::AddRef(p1_);
-  }
-  virtual ~BindState() {
-    MaybeRefcount<Runnable::IsMethod::value, P1>::Release(p1_);
-  }
-  Runnable runnable_;
-  P1 p1_;
-};
-
-template <typename Runnable, typename P1, typename P2>
-struct BindState<Runnable, void(P1, P2)> : public BindStateBase {
-  typedef IsWeakMethod<Runnable::IsMethod::value, P1> IsWeakCall;
-  typedef Invoker<IsWeakCall::value, BindState, typename Runnable::RunType> InvokerType;
-  typedef UnwrapTraits<P1> Bound1UnwrapTraits;
-  typedef UnwrapTraits<P2> Bound2UnwrapTraits;
-
-  BindState(const Runnable& runnable, const P1& p1, const P2& p2)
+// Holds the runnable and a decayed copy of every bound argument; rvalue
+// arguments are moved in rather than copied.  |RunType| is the signature of
+// the Callback it backs, i.e. the runnable's minus the bound arguments.
+template <typename Runnable, typename RunType, typename... BoundArgs>
+struct BindState<Runnable, RunType, void(BoundArgs...)> : public BindStateBase {
+  typedef IsWeakMethod<Runnable::IsMethod::value, BoundArgs...> IsWeakCall;
+  typedef Invoker<IsWeakCall::value, BindState, RunType> InvokerType;
+  typedef std::tuple<BoundArgs...> BoundArgsTuple;
+  typedef typename MakeIndexSequence<sizeof...(BoundArgs)>::Type BoundIndices;
+  typedef ReceiverRefcount<Runnable::IsMethod::value, BoundArgs...> Refcount;
+
+  template <typename... Args>
+  explicit BindState(const Runnable& runnable, Args&&... args)
     : runnable_(runnable)
-    , p1_(p1)
-    , p2_(p2) {
-    MaybeRefcount<Runnable::IsMethod::value, P1>::AddRef(p1_);
+    , bound_args_(std::forward<Args>(args)...) {
+    Refcount::AddRef(bound_args_);
   }
   virtual ~BindState() {
-    MaybeRefcount<Runnable::IsMethod::value, P1>::Release(p1_);
-  }
-  Runnable runnable_;
-  P1 p1_;
-  P2 p2_;
-};
-
-template <typename Runnable, typename P1, typename P2, typename P3>
-struct BindState<Runnable, void(P1, P2, P3)> : public BindStateBase {
-  typedef IsWeakMethod<Runnable::IsMethod::value, P1> IsWeakCall;
-  typedef Invoker<IsWeakCall::value, BindState, typename Runnable::RunType> InvokerType;
-  typedef UnwrapTraits<P1> Bound1UnwrapTraits;
-  typedef UnwrapTraits<P2> Bound2UnwrapTraits;
-  typedef UnwrapTraits<P3> Bound3UnwrapTraits;
-
-  BindState(const Runnable& runnable, const P1& p1, const P2& p2, const P3& p3)
-    : runnable_(runnable)
-    , p1_(p1)
-    , p2_(p2)
-    , p3_(p3) {
-      MaybeRefcount<Runnable::IsMethod::value, P1>::AddRef(p1_);
+    Refcount::Release(bound_args_);
   }
-  virtual ~BindState() {
-    MaybeRefcount<Runnable::IsMethod::value, P1>::Release(p1_);
+  virtual bool IsCancelled() const {
+    return CancellationTraits<IsWeakCall::value>::IsCancelled(bound_args_);
   }
   Runnable runnable_;
-  P1 p1_;
-  P2 p2_;
-  P3 p3_;
+  BoundArgsTuple bound_args_;
 };
 
-class Closure : public ClosureBase {
+template <typename Signature>
+class Callback;
+
+// A reference-counted handle to a bind state whose remaining arguments are
+// supplied to Run().  Copies share the bind state, so a callback bound once
+// can be run any number of times without allocating:
+//
+//   base::Callback<void(int)> on_read = base::Bind(&Reader::OnRead, this);
+//   ...
+//   on_read.Run(bytes_read);
+template <typename R, typename... Args>
+class Callback<R(Args...)> : public ClosureBase {
 public:
-  typedef void(RunType)();
+  typedef R(RunType)(Args...);
 
-  Closure() : ClosureBase(NULL) {}
+  Callback() : ClosureBase(NULL) {}
 
-  template <typename Runnable, typename BoundArgsType>
-  Closure(BindState<Runnable, BoundArgsType>* bind_state)
+  template <typename Runnable, typename BindRunType, typename BoundArgsType>
+  Callback(BindState<Runnable, BindRunType, BoundArgsType>* bind_state)
     : ClosureBase(bind_state) {
+    // Fails to compile unless the bind state was built for this signature.
     PolymorphicInvoke invoke_func =
-      &BindState<Runnable, BoundArgsType>::InvokerType::Run;
+      &BindState<Runnable, BindRunType, BoundArgsType>::InvokerType::Run;
     polymorphic_invoke_ = reinterpret_cast<InvokeFuncStorage>(invoke_func);
   }
 
-  bool Equals(const Closure& other) const {
+  bool Equals(const Callback& other) const {
     return ClosureBase::Equals(other);
   }
 
-  void Run() const {
+  R Run(typename CallbackParamTraits<Args>::ForwardType... args) const {
     PolymorphicInvoke f =
       reinterpret_cast<PolymorphicInvoke>(polymorphic_invoke_);
-    f(bind_state_.get());
+    return f(bind_state_.get(), CallbackForward(args)...);
   }
 private:
-  typedef void(*PolymorphicInvoke)(BindStateBase* bind_state);
+  typedef R(*PolymorphicInvoke)(BindStateBase* bind_state,
+    typename CallbackParamTraits<Args>::ForwardType...);
 };
 
-template <typename Functor>
-Closure Bind(Functor functor) {
-  typedef BindState<RunnableAdapter<Functor>, void()> BindState;
-  return Closure(new BindState(RunnableAdapter<Functor>(functor)));
+typedef Callback<void()> Closure;
+
+// Binds the leading arguments of a function or method; the rest are passed
+// to Run().  The receiver of a method comes first; a raw pointer to it is
+// AddRef'ed, and a call through an invalidated WeakPtr is dropped.
+template <typename Functor, typename... Args>
+Callback<typename DropArgs<sizeof...(Args), typename RunnableAdapter<Functor>::RunType>::Type>
+Bind(Functor functor, Args&&... args) {
+  typedef RunnableAdapter<Functor> Runnable;
+  typedef typename DropArgs<sizeof...(Args), typename Runnable::RunType>::Type UnboundRunType;
+  typedef BindState<Runnable, UnboundRunType,
+    void(typename CallbackParamTraits<typename std::decay<Args>::type>::StorageType...)> BindState;
+  return Callback<UnboundRunType>(new BindState(Runnable(functor), std::forward<Args>(args)...));
+}
+
+// Binds a raw pointer without AddRef'ing it, saving two atomic operations
+// per callback.  The caller guarantees the object outlives the callback.
+template <typename T>
+UnretainedWrapper<T> Unretained(T* o) {
+  return UnretainedWrapper<T>(o);
+}
+
+// Binds a reference to |o| instead of a copy.  The caller guarantees |o|
+// outlives the callback.
+template <typename T>
+ConstRefWrapper<T> ConstRef(const T& o) {
+  return ConstRefWrapper<T>(o);
 }
 
-template <typename Functor, typename P1>
-Closure Bind(Functor functor, const P1& p1) {
-  typedef BindState<RunnableAdapter<Functor>,
-    void(typename CallbackParamTraits<P1>::StorageType)> BindState;
-  return Closure(new BindState(RunnableAdapter<Functor>(functor), p1));
+// Hands |o| to the callback, which deletes it when it is destroyed.  The
+// callee gets a raw pointer on every run.
+template <typename T>
+OwnedWrapper<T> Owned(T* o) {
+  return OwnedWrapper<T>(o);
 }
 
-template <typename Functor, typename P1, typename P2>
-Closure Bind(Functor functor, const P1& p1, const P2& p2) {
-  typedef BindState<RunnableAdapter<Functor>,
-    void(typename CallbackParamTraits<P1>::StorageType,
-    typename CallbackParamTraits<P2>::StorageType)> BindState;
-  return Closure(new BindState(RunnableAdapter<Functor>(functor), p1, p2));
+// Moves a move-only value into the callback and out again, into the callee,
+// when it runs.  Usable for any argument, not only the last; the callback
+// may only run once.
+//
+//   scoped_ptr<Foo> foo(new Foo);
+//   base::Closure task = base::Bind(&TakesFoo, base::Passed(&foo));
+template <typename T>
+PassedWrapper<T> Passed(T* scoper) {
+  return PassedWrapper<T>(std::move(*scoper));
 }
 
-template <typename Functor, typename P1, typename P2, typename P3>
-Closure Bind(Functor functor, const P1& p1, const P2& p2, const P3& p3) {
-  typedef BindState<RunnableAdapter<Functor>,
-    void(typename CallbackParamTraits<P1>::StorageType,
-    typename CallbackParamTraits<P2>::StorageType,
-    typename CallbackParamTraits<P3>::StorageType)> BindState;
-  return Closure(new BindState(RunnableAdapter<Functor>(functor), p1, p2, p3));
+template <typename T, typename = typename std::enable_if<
+  !std::is_lvalue_reference<T>::value>::type>
+PassedWrapper<T> Passed(T&& scoper) {
+  return PassedWrapper<T>(std::move(scoper));
 }
 }
 
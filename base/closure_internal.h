@@ -1,6 +1,11 @@
 #ifndef BASE_CLOSURE_INTERNAL_H_
 #define BASE_CLOSURE_INTERNAL_H_
 
+#include <assert.h>
+#include <stddef.h>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include "base/ref_counted.h"
 #include "base/scoped_ptr.h"
 #include "base/weak_ptr.h"
@@ -16,26 +21,82 @@ struct boolean_type {
 typedef boolean_type<true> true_type;
 typedef boolean_type<false> false_type;
 
-template <bool IsMethod, typename P1>
+template <size_t... Indices>
+struct IndexSequence {};
+
+template <size_t N, size_t... Indices>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, Indices...> {};
+
+template <size_t... Indices>
+struct MakeIndexSequence<0, Indices...> {
+  typedef IndexSequence<Indices...> Type;
+};
+
+// A bound method whose receiver, the first bound argument, is a WeakPtr.
+template <bool IsMethod, typename... BoundArgs>
 struct IsWeakMethod : public false_type {};
 
-template <typename T>
-struct IsWeakMethod<true, WeakPtr<T> > : public true_type {};
+template <typename T, typename... BoundArgs>
+struct IsWeakMethod<true, WeakPtr<T>, BoundArgs...> : public true_type {};
 
-template <typename T>
+// Whether running a bound call would do nothing.  Only a weak call can be
+// cancelled, once its receiver has been invalidated.
+template <bool IsWeakCall>
+struct CancellationTraits {
+  template <typename Tuple>
+  static bool IsCancelled(const Tuple&) { return false; }
+};
+
+template <>
+struct CancellationTraits<true> {
+  template <typename Tuple>
+  static bool IsCancelled(const Tuple& bound_args) {
+    return !std::get<0>(bound_args).get();
+  }
+};
+
+// The signature left once the first |N| arguments of |Signature| are bound.
+template <bool Done, size_t N, typename R, typename... Args>
+struct DropArgsImpl;
+
+template <size_t N, typename R, typename... Args>
+struct DropArgsImpl<true, N, R, Args...> {
+  typedef R(Type)(Args...);
+};
+
+template <size_t N, typename R, typename A1, typename... Args>
+struct DropArgsImpl<false, N, R, A1, Args...>
+  : DropArgsImpl<N == 1, N - 1, R, Args...> {};
+
+template <size_t N, typename Signature>
+struct DropArgs;
+
+template <size_t N, typename R, typename... Args>
+struct DropArgs<N, R(Args...)> : DropArgsImpl<N == 0, N, R, Args...> {};
+
+// How an argument travels through Run(): copyable ones by const reference,
+// move-only ones (scoped_ptr, std::unique_ptr) by value.
+template <typename T, typename Enable = void>
 struct CallbackParamTraits {
   typedef const T& ForwardType;
   typedef T StorageType;
 };
 
-template <typename T, typename D>
-struct CallbackParamTraits<scoped_ptr<T, D> > {
-  typedef scoped_ptr<T, D> ForwardType;
-  typedef scoped_ptr<T, D> StorageType;
+template <typename T>
+struct CallbackParamTraits<T, typename std::enable_if<!std::is_copy_constructible<T>::value>::type> {
+  typedef T ForwardType;
+  typedef T StorageType;
 };
 
+// Copyable arguments are passed on as lvalues, so a closure can run again.
+// Move-only ones are moved out, so the closure must only run once.
+template <typename T>
+typename std::enable_if<std::is_copy_constructible<T>::value, T&>::type
+CallbackForward(T& t) { return t; }
+
 template <typename T>
-T& CallbackForward(T& t) { return t; }
+typename std::enable_if<!std::is_copy_constructible<T>::value, T&&>::type
+CallbackForward(T& t) { return std::move(t); }
 
 template <typename T, typename D>
 scoped_ptr<T, D> CallbackForward(scoped_ptr<T, D>& p) { return p.Pass(); }
@@ -49,6 +110,8 @@ struct MaybeRefcount<false, T> {
   static void Release(const T&) {}
 };
 
+// Receivers held by a smart pointer, WeakPtr, Unretained() or Owned() need
+// no extra reference.
 template <typename T>
 struct MaybeRefcount<true, T> {
   static void AddRef(const T&) {}
@@ -67,12 +130,95 @@ struct MaybeRefcount<true, const T*> {
   static void Release(const T* o) { o->Release(); }
 };
 
+// Keeps a raw receiver pointer alive for as long as the bind state holds it.
+template <bool is_method, typename... BoundArgs>
+struct ReceiverRefcount {
+  template <typename Tuple>
+  static void AddRef(const Tuple&) {}
+  template <typename Tuple>
+  static void Release(const Tuple&) {}
+};
+
+template <typename P1, typename... BoundArgs>
+struct ReceiverRefcount<true, P1, BoundArgs...> {
+  static void AddRef(const std::tuple<P1, BoundArgs...>& bound_args) {
+    MaybeRefcount<true, P1>::AddRef(std::get<0>(bound_args));
+  }
+  static void Release(const std::tuple<P1, BoundArgs...>& bound_args) {
+    MaybeRefcount<true, P1>::Release(std::get<0>(bound_args));
+  }
+};
+
+// Storage for the argument wrappers in closure.h.  Copying an OwnedWrapper or
+// a PassedWrapper hands over what it holds, like scoped_ptr's Pass().
 template <typename T>
+class UnretainedWrapper {
+public:
+  explicit UnretainedWrapper(T* o) : ptr_(o) {}
+  T* get() const { return ptr_; }
+private:
+  T* ptr_;
+};
+
+template <typename T>
+class ConstRefWrapper {
+public:
+  explicit ConstRefWrapper(const T& o) : ptr_(&o) {}
+  const T& get() const { return *ptr_; }
+private:
+  const T* ptr_;
+};
+
+template <typename T>
+class OwnedWrapper {
+public:
+  explicit OwnedWrapper(T* o) : ptr_(o) {}
+  OwnedWrapper(const OwnedWrapper& other) : ptr_(other.ptr_) {
+    other.ptr_ = NULL;
+  }
+  ~OwnedWrapper() { delete ptr_; }
+  T* get() const { return ptr_; }
+private:
+  mutable T* ptr_;
+  void operator=(const OwnedWrapper&);
+};
+
+template <typename T>
+class PassedWrapper {
+public:
+  explicit PassedWrapper(T&& scoper)
+    : is_valid_(true)
+    , scoper_(std::move(scoper)) {}
+  PassedWrapper(const PassedWrapper& other)
+    : is_valid_(other.is_valid_)
+    , scoper_(std::move(other.scoper_)) {
+    other.is_valid_ = false;
+  }
+  // The value can only be handed to the callee once.
+  T Take() const {
+    assert(is_valid_);
+    is_valid_ = false;
+    return std::move(scoper_);
+  }
+private:
+  mutable bool is_valid_;
+  mutable T scoper_;
+  void operator=(const PassedWrapper&);
+};
+
+template <typename T, typename Enable = void>
 struct UnwrapTraits {
   typedef const T& ForwardType;
   static ForwardType Unwrap(const T& o) { return o; }
 };
 
+// Move-only values are handed out as lvalues for CallbackForward() to move.
+template <typename T>
+struct UnwrapTraits<T, typename std::enable_if<!std::is_copy_constructible<T>::value>::type> {
+  typedef T& ForwardType;
+  static ForwardType Unwrap(T& o) { return o; }
+};
+
 template <typename T>
 struct UnwrapTraits<scoped_refptr<T> > {
   typedef T* ForwardType;
@@ -85,215 +231,117 @@ struct UnwrapTraits<WeakPtr<T> > {
   static ForwardType Unwrap(const WeakPtr<T>& o) { return o; }
 };
 
-template<bool IsWeakCall, typename Storage, typename RunType>
-struct Invoker;
-
-template <typename Functor>
-class RunnableAdapter;
+template <typename T>
+struct UnwrapTraits<UnretainedWrapper<T> > {
+  typedef T* ForwardType;
+  static ForwardType Unwrap(const UnretainedWrapper<T>& o) { return o.get(); }
+};
 
-template<>
-class RunnableAdapter<void(*)()> {
-public:
-  typedef void (RunType)();
-  typedef false_type IsMethod;
-  explicit RunnableAdapter(void(*function)())
-    : function_(function) {}
-  void Run() {
-    function_();
-  }
-private:
-  void (*function_)();
+template <typename T>
+struct UnwrapTraits<ConstRefWrapper<T> > {
+  typedef const T& ForwardType;
+  static ForwardType Unwrap(const ConstRefWrapper<T>& o) { return o.get(); }
 };
 
 template <typename T>
-class RunnableAdapter<void(T::*)()> {
-public:
-  typedef void (RunType)(T*);
-  typedef true_type IsMethod;
-  explicit RunnableAdapter(void(T::*method)())
-    : method_(method) {}
-  void Run(T* object) {
-    (object->*method_)();
-  }
-private:
-  void (T::*method_)();
+struct UnwrapTraits<OwnedWrapper<T> > {
+  typedef T* ForwardType;
+  static ForwardType Unwrap(const OwnedWrapper<T>& o) { return o.get(); }
 };
 
-template <typename A1>
-class RunnableAdapter<void(*)(A1)> {
-public:
-  typedef void (RunType)(A1);
-  typedef false_type IsMethod;
-  explicit RunnableAdapter(void(*function)(A1))
-    : function_(function) {}
-  void Run(typename CallbackParamTraits<A1>::ForwardType a1) {
-    function_(CallbackForward(a1));
-  }
-private:
-  void (*function_)(A1);
+template <typename T>
+struct UnwrapTraits<PassedWrapper<T> > {
+  typedef T ForwardType;
+  static ForwardType Unwrap(const PassedWrapper<T>& o) { return o.Take(); }
 };
 
-template <typename A1, typename A2>
-class RunnableAdapter<void(*)(A1, A2)> {
+template <typename Functor>
+class RunnableAdapter;
+
+template <typename R, typename... Args>
+class RunnableAdapter<R(*)(Args...)> {
 public:
-  typedef void (RunType)(A1, A2);
+  typedef R (RunType)(Args...);
   typedef false_type IsMethod;
-  explicit RunnableAdapter(void(*function)(A1, A2))
+  explicit RunnableAdapter(R(*function)(Args...))
     : function_(function) {}
-  void Run(typename CallbackParamTraits<A1>::ForwardType a1,
-    typename CallbackParamTraits<A2>::ForwardType a2) {
-      function_(CallbackForward(a1), CallbackForward(a2));
+  template <typename... RunArgs>
+  R Run(RunArgs&&... args) {
+    return function_(std::forward<RunArgs>(args)...);
   }
 private:
-  void (*function_)(A1, A2);
+  R (*function_)(Args...);
 };
 
-template <typename T, typename A1>
-class RunnableAdapter<void(T::*)(A1)> {
+template <typename R, typename T, typename... Args>
+class RunnableAdapter<R(T::*)(Args...)> {
 public:
-  typedef void (RunType)(T*, A1);
+  typedef R (RunType)(T*, Args...);
   typedef true_type IsMethod;
-  explicit RunnableAdapter(void(T::*method)(A1))
+  explicit RunnableAdapter(R(T::*method)(Args...))
     : method_(method) {}
-  void Run(T* object, typename CallbackParamTraits<A1>::ForwardType a1) {
-    (object->*method_)(CallbackForward(a1));
-  }
-private:
-  void (T::*method_)(A1);
-};
-
-template <typename A1, typename A2, typename A3>
-class RunnableAdapter<void(*)(A1, A2, A3)> {
-public:
-  typedef void (RunType)(A1, A2, A3);
-  typedef false_type IsMethod;
-  explicit RunnableAdapter(void(*function)(A1, A2, A3))
-    : function_(function) {}
-  void Run(typename CallbackParamTraits<A1>::ForwardType a1,
-    typename CallbackParamTraits<A2>::ForwardType a2,
-    typename CallbackParamTraits<A3>::ForwardType a3) {
-      function_(CallbackForward(a1), CallbackForward(a2), CallbackForward(a3));
+  template <typename... RunArgs>
+  R Run(T* object, RunArgs&&... args) {
+    return (object->*method_)(std::forward<RunArgs>(args)...);
   }
 private:
-  void (*function_)(A1, A2, A3);
+  R (T::*method_)(Args...);
 };
 
-template <typename T, typename A1, typename A2>
-class RunnableAdapter<void(T::*)(A1, A2)> {
+template <typename R, typename T, typename... Args>
+class RunnableAdapter<R(T::*)(Args...) const> {
 public:
-  typedef void (RunType)(T*, A1, A2);
+  typedef R (RunType)(const T*, Args...);
   typedef true_type IsMethod;
-  explicit RunnableAdapter(void(T::*method)(A1, A2))
+  explicit RunnableAdapter(R(T::*method)(Args...) const)
     : method_(method) {}
-  void Run(T* object, typename CallbackParamTraits<A1>::ForwardType a1,
-    typename CallbackParamTraits<A2>::ForwardType a2) {
-    (object->*method_)(CallbackForward(a1), CallbackForward(a2));
+  template <typename... RunArgs>
+  R Run(const T* object, RunArgs&&... args) {
+    return (object->*method_)(std::forward<RunArgs>(args)...);
   }
 private:
-  void (T::*method_)(A1, A2);
-};
-
-template <typename StorageType>
-struct Invoker<false, StorageType, void()> {
-  static void Run(BindStateBase* base) {
-    StorageType* storage = static_cast<StorageType*>(base);
-    storage->runnable_.Run();
-  }
-};
-
-template <typename StorageType, typename X1>
-struct Invoker<false, StorageType, void(X1)> {
-  static void Run(BindStateBase* base) {
-    StorageType* storage = static_cast<StorageType*>(base);
-    typedef typename StorageType::Bound1UnwrapTraits Bound1UnwrapTraits;
-    typename Bound1UnwrapTraits::ForwardType x1 =
-      Bound1UnwrapTraits::Unwrap(storage->p1_);
-
-    storage->runnable_.Run(CallbackForward(x1));
-  }
+  R (T::*method_)(Args...) const;
 };
 
-template <typename StorageType, typename X1>
-struct Invoker<true, StorageType, void(X1)> {
-  static void Run(BindStateBase* base) {
-    StorageType* storage = static_cast<StorageType*>(base);
-    typedef typename StorageType::Bound1UnwrapTraits Bound1UnwrapTraits;
-    typename Bound1UnwrapTraits::ForwardType x1 =
-      Bound1UnwrapTraits::Unwrap(storage->p1_);
-
-    if (!CallbackForward(x1).get())
-      return;
-    storage->runnable_.Run(CallbackForward(x1).get());
-  }
-};
+// Calls the runnable of |StorageType| with its unwrapped bound arguments
+// followed by the ones given to Callback::Run().  A weak call is dropped once
+// its receiver has been invalidated.
+template <bool IsWeakCall, typename StorageType, typename RunType>
+struct Invoker;
 
-template <typename StorageType, typename X1, typename X2>
-struct Invoker<false, StorageType, void(X1, X2)> {
-  static void Run(BindStateBase* base) {
+template <bool IsWeakCall, typename StorageType, typename R, typename... Unbound>
+struct Invoker<IsWeakCall, StorageType, R(Unbound...)> {
+  static R Run(BindStateBase* base,
+    typename CallbackParamTraits<Unbound>::ForwardType... unbound) {
     StorageType* storage = static_cast<StorageType*>(base);
-    typedef typename StorageType::Bound1UnwrapTraits Bound1UnwrapTraits;
-    typedef typename StorageType::Bound2UnwrapTraits Bound2UnwrapTraits;
-    typename Bound1UnwrapTraits::ForwardType x1 =
-      Bound1UnwrapTraits::Unwrap(storage->p1_);
-    typename Bound2UnwrapTraits::ForwardType x2 =
-      Bound2UnwrapTraits::Unwrap(storage->p2_);
-
-    storage->runnable_.Run(CallbackForward(x1), CallbackForward(x2));
+    return RunBound(storage, typename StorageType::BoundIndices(), unbound...);
   }
-};
 
-template <typename StorageType, typename X1, typename X2>
-struct Invoker<true, StorageType, void(X1, X2)> {
-  static void Run(BindStateBase* base) {
-    StorageType* storage = static_cast<StorageType*>(base);
-    typedef typename StorageType::Bound1UnwrapTraits Bound1UnwrapTraits;
-    typedef typename StorageType::Bound2UnwrapTraits Bound2UnwrapTraits;
-    typename Bound1UnwrapTraits::ForwardType x1 =
-      Bound1UnwrapTraits::Unwrap(storage->p1_);
-    typename Bound2UnwrapTraits::ForwardType x2 =
-      Bound2UnwrapTraits::Unwrap(storage->p2_);
-
-    if (!CallbackForward(x1).get())
-      return;
-    storage->runnable_.Run(CallbackForward(x1).get(), CallbackForward(x2));
+private:
+  typedef typename StorageType::BoundArgsTuple BoundArgsTuple;
+
+  template <size_t... Indices, typename... UnboundArgs>
+  static R RunBound(StorageType* storage, IndexSequence<Indices...>,
+    UnboundArgs&... unbound) {
+    return Call(boolean_type<IsWeakCall>(), storage->runnable_,
+      UnwrapTraits<typename std::tuple_element<Indices, BoundArgsTuple>::type>::Unwrap(
+        std::get<Indices>(storage->bound_args_))...,
+      unbound...);
   }
-};
 
-template <typename StorageType, typename X1, typename X2, typename X3>
-struct Invoker<false, StorageType, void(X1, X2, X3)> {
-  static void Run(BindStateBase* base) {
-    StorageType* storage = static_cast<StorageType*>(base);
-    typedef typename StorageType::Bound1UnwrapTraits Bound1UnwrapTraits;
-    typedef typename StorageType::Bound2UnwrapTraits Bound2UnwrapTraits;
-    typedef typename StorageType::Bound3UnwrapTraits Bound3UnwrapTraits;
-    typename Bound1UnwrapTraits::ForwardType x1 =
-      Bound1UnwrapTraits::Unwrap(storage->p1_);
-    typename Bound2UnwrapTraits::ForwardType x2 =
-      Bound2UnwrapTraits::Unwrap(storage->p2_);
-    typename Bound3UnwrapTraits::ForwardType x3 =
-      Bound3UnwrapTraits::Unwrap(storage->p3_);
-
-    storage->runnable_.Run(CallbackForward(x1), CallbackForward(x2), CallbackForward(x3));
+  template <typename Runnable, typename... Unwrapped>
+  static R Call(false_type, Runnable& runnable, Unwrapped&&... args) {
+    return runnable.Run(CallbackForward(args)...);
   }
-};
 
-template <typename StorageType, typename X1, typename X2, typename X3>
-struct Invoker<true, StorageType, void(X1, X2, X3)> {
-  static void Run(BindStateBase* base) {
-    StorageType* storage = static_cast<StorageType*>(base);
-    typedef typename StorageType::Bound1UnwrapTraits Bound1UnwrapTraits;
-    typedef typename StorageType::Bound2UnwrapTraits Bound2UnwrapTraits;
-    typedef typename StorageType::Bound3UnwrapTraits Bound3UnwrapTraits;
-    typename Bound1UnwrapTraits::ForwardType x1 =
-      Bound1UnwrapTraits::Unwrap(storage->p1_);
-    typename Bound2UnwrapTraits::ForwardType x2 =
-      Bound2UnwrapTraits::Unwrap(storage->p2_);
-    typename Bound3UnwrapTraits::ForwardType x3 =
-      Bound3UnwrapTraits::Unwrap(storage->p3_);
-
-    if (!CallbackForward(x1).get())
+  template <typename Runnable, typename WeakReceiver, typename... Unwrapped>
+  static R Call(true_type, Runnable& runnable, WeakReceiver&& receiver,
+    Unwrapped&&... args) {
+    static_assert(std::is_void<R>::value,
+      "weak calls may be dropped, so they cannot return a value");
+    if (!receiver.get())
       return;
-    storage->runnable_.Run(CallbackForward(x1).get(), CallbackForward(x2), CallbackForward(x3));
+    runnable.Run(receiver.get(), CallbackForward(args)...);
   }
 };
 }
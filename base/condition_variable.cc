@@ -0,0 +1,46 @@
+#include "base/condition_variable.h"
+
+#include "base/futex.h"
+
+namespace base {
+
+ConditionVariable::ConditionVariable(Lock* user_lock)
+  : sequence_(0)
+  , waiters_(0)
+  , user_lock_(user_lock) {
+}
+
+ConditionVariable::~ConditionVariable() {
+}
+
+void ConditionVariable::Wait() {
+  int sequence = sequence_.load(std::memory_order_relaxed);
+  waiters_.fetch_add(1);
+  user_lock_->Release();
+  internal::FutexWait(&sequence_, sequence);
+  user_lock_->Acquire();
+  waiters_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ConditionVariable::TimedWait(TimeDelta max_time_ms) {
+  int sequence = sequence_.load(std::memory_order_relaxed);
+  waiters_.fetch_add(1);
+  user_lock_->Release();
+  internal::FutexWaitFor(&sequence_, sequence, max_time_ms);
+  user_lock_->Acquire();
+  waiters_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ConditionVariable::Signal() {
+  sequence_.fetch_add(1);
+  if (waiters_.load() > 0)
+    internal::FutexWakeOne(&sequence_);
+}
+
+void ConditionVariable::Broadcast() {
+  sequence_.fetch_add(1);
+  if (waiters_.load() > 0)
+    internal::FutexWakeAll(&sequence_);
+}
+
+}  // namespace base
@@ -0,0 +1,44 @@
+#ifndef BASE_CONDITION_VARIABLE_H_
+#define BASE_CONDITION_VARIABLE_H_
+
+#include <atomic>
+
+#include "base/lock.h"
+#include "base/time.h"
+
+namespace base {
+
+// A condition variable bound to a base::Lock.  Wait() must be called with the
+// lock held; it is released while blocked and re-acquired before returning.
+// Wake-ups may be spurious, so always wait in a loop on the real predicate:
+//
+//   base::AutoLock locked(lock_);
+//   while (queue_.empty())
+//     queue_not_empty_.Wait();
+class BASE_EXPORT ConditionVariable {
+public:
+  explicit ConditionVariable(Lock* user_lock);
+  ~ConditionVariable();
+
+  void Wait();
+  // Waits for at most |max_time_ms|.  Callers cannot tell a timeout from a
+  // signal and should re-check their predicate and the clock.
+  void TimedWait(TimeDelta max_time_ms);
+
+  // Wakes one waiter, or all of them.
+  void Signal();
+  void Broadcast();
+
+private:
+  // Bumped by every Signal()/Broadcast(); waiters sleep on the value they
+  // observed while still holding |user_lock_|, so no wake-up can be lost.
+  std::atomic<int> sequence_;
+  std::atomic<int> waiters_;
+  Lock* const user_lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConditionVariable);
+};
+
+}  // namespace base
+
+#endif
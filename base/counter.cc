@@ -0,0 +1,29 @@
+#include "base/counter.h"
+
+namespace base {
+
+namespace internal {
+
+BASE_THREAD_LOCAL_POD size_t t_counter_shard;
+
+size_t AssignCounterShard() {
+  static std::atomic<size_t> next_shard(0);
+  t_counter_shard = next_shard.fetch_add(1, std::memory_order_relaxed) + 1;
+  return t_counter_shard;
+}
+
+}  // namespace internal
+
+Counter::Counter() {
+  for (size_t i = 0; i < kShards; ++i)
+    shards_[i].value.store(0, std::memory_order_relaxed);
+}
+
+long long Counter::value() const {
+  long long total = 0;
+  for (size_t i = 0; i < kShards; ++i)
+    total += shards_[i].value.load(std::memory_order_relaxed);
+  return total;
+}
+
+}  // namespace base
@@ -0,0 +1,57 @@
+#ifndef BASE_COUNTER_H_
+#define BASE_COUNTER_H_
+
+#include <stddef.h>
+#include <atomic>
+
+namespace base {
+
+namespace internal {
+
+// The counter shard of the calling thread, plus one; 0 until first use.
+extern BASE_THREAD_LOCAL_POD size_t t_counter_shard;
+
+size_t AssignCounterShard();
+
+// A small index for the calling thread, stable for its lifetime, spreading
+// threads evenly over |shard_count| shards.
+inline size_t ThreadShardIndex(size_t shard_count) {
+  size_t shard = t_counter_shard;
+  if (!shard)
+    shard = AssignCounterShard();
+  return (shard - 1) % shard_count;
+}
+
+}  // namespace internal
+
+// A counter that many threads bump at once without bouncing a cache line
+// between them.  Threads are spread over kShards shards, each on its own
+// cache line; value() adds them up, so it may miss increments made while
+// it runs.
+class BASE_EXPORT Counter {
+public:
+  static const size_t kShards = 16;
+
+  Counter();
+
+  void Increment(long long delta = 1) {
+    shards_[internal::ThreadShardIndex(kShards)].value.fetch_add(
+      delta, std::memory_order_relaxed);
+  }
+
+  long long value() const;
+
+private:
+  struct Shard {
+    std::atomic<long long> value;
+    char padding[64 - sizeof(std::atomic<long long>)];
+  };
+
+  Shard shards_[kShards];
+
+  DISALLOW_COPY_AND_ASSIGN(Counter);
+};
+
+}  // namespace base
+
+#endif
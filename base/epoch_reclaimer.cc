@@ -0,0 +1,269 @@
+#include "base/epoch_reclaimer.h"
+
+#include <atomic>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "base/lock.h"
+
+namespace base {
+
+namespace {
+
+// Epochs advance in steps of two so that the low bit of a thread's announced
+// epoch can mark it online; an offline thread announces 0.
+const size_t kOnline = 1;
+const size_t kEpochStep = 2;
+// A batch retired in epoch E is freed once the epoch reaches E + 2: every
+// thread online at the time of the retirement has announced a quiescent
+// state since.
+const size_t kGracePeriod = 2 * kEpochStep;
+
+struct RetiredObject {
+  void* object;
+  void (*deleter)(void*);
+};
+
+struct RetiredBatch {
+  size_t epoch;
+  std::vector<RetiredObject> objects;
+};
+
+struct ThreadRecord {
+  ThreadRecord() : announced(0), in_use(false), next(NULL) {}
+
+  std::atomic<size_t> announced;
+  std::atomic<bool> in_use;
+  // Set before the record is published and never changed afterwards.
+  ThreadRecord* next;
+  // Owner thread only.
+  std::vector<RetiredObject> pending;
+  std::deque<RetiredBatch> batches;
+};
+
+// Records are never freed; those of exited threads are reused.
+std::atomic<ThreadRecord*> g_records(NULL);
+std::atomic<size_t> g_epoch(0);
+
+// Batches retired by unregistered or exited threads, freed by whichever
+// thread gets to them.
+struct Orphans {
+  Lock lock;
+  std::vector<RetiredBatch> batches;
+};
+
+// Leaked so that objects can still be retired during static destruction.
+Orphans* GetOrphans() {
+  static Orphans* orphans = new Orphans();
+  return orphans;
+}
+
+std::atomic<size_t> g_orphan_count(0);
+
+thread_local ThreadRecord* t_record = NULL;
+
+ThreadRecord* AcquireRecord() {
+  for (ThreadRecord* record = g_records.load(std::memory_order_acquire); record;
+    record = record->next) {
+    bool in_use = false;
+    if (!record->in_use.load(std::memory_order_relaxed) &&
+      record->in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire))
+      return record;
+  }
+  ThreadRecord* record = new ThreadRecord();
+  record->in_use.store(true, std::memory_order_relaxed);
+  ThreadRecord* head = g_records.load(std::memory_order_relaxed);
+  do {
+    record->next = head;
+  } while (!g_records.compare_exchange_weak(head, record,
+    std::memory_order_release, std::memory_order_relaxed));
+  return record;
+}
+
+void Announce(ThreadRecord* record) {
+  // Release, so that the reads made before it happen before a reclaimer that
+  // sees the announcement frees anything.
+  record->announced.store(g_epoch.load(std::memory_order_relaxed) | kOnline,
+    std::memory_order_release);
+  // Orders the announcement before any read that follows it.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+// Moves the epoch on if every online thread has announced the current one.
+// Returns false if a thread held it back.
+bool TryAdvance() {
+  size_t epoch = g_epoch.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  for (ThreadRecord* record = g_records.load(std::memory_order_acquire); record;
+    record = record->next) {
+    size_t announced = record->announced.load(std::memory_order_acquire);
+    if ((announced & kOnline) && (announced & ~kOnline) != epoch)
+      return false;
+  }
+  // Another thread moving it on first is just as good.
+  g_epoch.compare_exchange_strong(epoch, epoch + kEpochStep,
+    std::memory_order_release, std::memory_order_relaxed);
+  return true;
+}
+
+// Tags |objects| with the epoch they were retired in.  The fence orders
+// their unlinking before the epoch is read.
+RetiredBatch Seal(std::vector<RetiredObject>* objects) {
+  RetiredBatch batch;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  batch.epoch = g_epoch.load(std::memory_order_relaxed);
+  batch.objects.swap(*objects);
+  return batch;
+}
+
+bool IsExpired(const RetiredBatch& batch, size_t epoch) {
+  return epoch - batch.epoch >= kGracePeriod;
+}
+
+void FreeBatch(RetiredBatch* batch) {
+  for (size_t i = 0; i < batch->objects.size(); ++i)
+    batch->objects[i].deleter(batch->objects[i].object);
+}
+
+void AddOrphans(RetiredBatch* batches, size_t count) {
+  Orphans* orphans = GetOrphans();
+  AutoLock locked(orphans->lock);
+  for (size_t i = 0; i < count; ++i)
+    orphans->batches.push_back(std::move(batches[i]));
+  g_orphan_count.store(orphans->batches.size(), std::memory_order_relaxed);
+}
+
+void FreeExpiredOrphans(size_t epoch) {
+  Orphans* orphans = GetOrphans();
+  std::vector<RetiredBatch> expired;
+  // Not worth waiting for: another thread is already at it.
+  if (!orphans->lock.Try())
+    return;
+  {
+    AutoLock locked(orphans->lock, AutoLock::AlreadyAcquired());
+    std::vector<RetiredBatch> kept;
+    for (size_t i = 0; i < orphans->batches.size(); ++i) {
+      if (IsExpired(orphans->batches[i], epoch))
+        expired.push_back(std::move(orphans->batches[i]));
+      else
+        kept.push_back(std::move(orphans->batches[i]));
+    }
+    orphans->batches.swap(kept);
+    g_orphan_count.store(orphans->batches.size(), std::memory_order_relaxed);
+  }
+  // Deleters may retire more objects, so they run without the lock.
+  for (size_t i = 0; i < expired.size(); ++i)
+    FreeBatch(&expired[i]);
+}
+
+void FreeExpiredBatches(ThreadRecord* record, size_t epoch) {
+  while (!record->batches.empty() && IsExpired(record->batches.front(), epoch)) {
+    RetiredBatch batch = std::move(record->batches.front());
+    record->batches.pop_front();
+    FreeBatch(&batch);
+  }
+}
+
+void Reclaim(ThreadRecord* record) {
+  if (!record->pending.empty())
+    record->batches.push_back(Seal(&record->pending));
+  TryAdvance();
+  size_t epoch = g_epoch.load(std::memory_order_acquire);
+  FreeExpiredBatches(record, epoch);
+  if (g_orphan_count.load(std::memory_order_relaxed))
+    FreeExpiredOrphans(epoch);
+}
+
+bool HasGarbage(const ThreadRecord* record) {
+  return !record->pending.empty() || !record->batches.empty() ||
+    g_orphan_count.load(std::memory_order_relaxed) != 0;
+}
+
+}  // namespace
+
+// static
+void EpochReclaimer::RegisterThread() {
+  if (t_record)
+    return;
+  t_record = AcquireRecord();
+  Announce(t_record);
+}
+
+// static
+void EpochReclaimer::UnregisterThread() {
+  ThreadRecord* record = t_record;
+  if (!record)
+    return;
+  Reclaim(record);
+  record->announced.store(0, std::memory_order_release);
+  if (!record->pending.empty())
+    record->batches.push_back(Seal(&record->pending));
+  // Offline, the thread no longer holds the epoch back, so unless another
+  // reader is in the middle of something its garbage can go right away.
+  while (!record->batches.empty() &&
+    !IsExpired(record->batches.back(), g_epoch.load(std::memory_order_relaxed)) &&
+    TryAdvance()) {
+  }
+  FreeExpiredBatches(record, g_epoch.load(std::memory_order_acquire));
+  // Retired by the deleters above.
+  if (!record->pending.empty())
+    record->batches.push_back(Seal(&record->pending));
+  if (!record->batches.empty()) {
+    std::vector<RetiredBatch> batches(
+      std::make_move_iterator(record->batches.begin()),
+      std::make_move_iterator(record->batches.end()));
+    record->batches.clear();
+    AddOrphans(&batches[0], batches.size());
+  }
+  t_record = NULL;
+  record->in_use.store(false, std::memory_order_release);
+}
+
+// static
+void EpochReclaimer::QuiescentState() {
+  ThreadRecord* record = t_record;
+  if (!record)
+    return;
+  Announce(record);
+  if (HasGarbage(record))
+    Reclaim(record);
+}
+
+// static
+void EpochReclaimer::ThreadOffline() {
+  ThreadRecord* record = t_record;
+  if (!record)
+    return;
+  // Last chance to free anything before a possibly long wait.
+  if (HasGarbage(record)) {
+    Announce(record);
+    Reclaim(record);
+  }
+  record->announced.store(0, std::memory_order_release);
+}
+
+// static
+void EpochReclaimer::ThreadOnline() {
+  if (t_record)
+    Announce(t_record);
+}
+
+// static
+void EpochReclaimer::Retire(void* object, void (*deleter)(void*)) {
+  RetiredObject retired = { object, deleter };
+  ThreadRecord* record = t_record;
+  if (record) {
+    // Sealed and freed at the thread's next quiescent state.
+    record->pending.push_back(retired);
+    return;
+  }
+
+  std::vector<RetiredObject> objects(1, retired);
+  RetiredBatch batch = Seal(&objects);
+  AddOrphans(&batch, 1);
+  TryAdvance();
+  FreeExpiredOrphans(g_epoch.load(std::memory_order_acquire));
+}
+
+}  // namespace base
@@ -0,0 +1,68 @@
+#ifndef BASE_EPOCH_RECLAIMER_H_
+#define BASE_EPOCH_RECLAIMER_H_
+
+#include <stddef.h>
+
+namespace base {
+
+// Epoch-based reclamation for lock-free structures that are read far more
+// often than they change, such as registries and routing tables published
+// through an atomic pointer.  A writer unlinks an object and hands it to
+// Retire(); it is freed once every registered thread has passed through a
+// quiescent state, a point where it holds no pointer into any protected
+// structure.  Readers only load the pointer: no reference count, no lock
+// and no atomic write.
+//
+// MessageLoop threads are registered, announce a quiescent state after each
+// task and are offline while waiting for messages.  Tasks may therefore read
+// protected structures freely, as long as they keep no pointer into them
+// past the end of the task, or across a nested message loop.  A loop stuck
+// in a modal dialog's message pump delays reclamation, but stays safe.
+// Other threads call RegisterThread() and then QuiescentState() regularly,
+// or use HazardPointer instead.
+//
+//   // Readers, in any task:
+//   const RouteMap* routes = g_routes.load(std::memory_order_acquire);
+//   RouteMap::const_iterator iter = routes->find(key);
+//
+//   // Writers, serialized by a lock:
+//   RouteMap* updated = new RouteMap(*g_routes.load(std::memory_order_relaxed));
+//   (*updated)[key] = route;
+//   base::EpochReclaimer::Delete(g_routes.exchange(updated));
+class BASE_EXPORT EpochReclaimer {
+public:
+  // Makes the calling thread a reader.  It starts online.
+  static void RegisterThread();
+  // Must be called before a registered thread exits.  What it retired is
+  // freed right away if no other reader can still see it, and otherwise
+  // left for other threads to free.
+  static void UnregisterThread();
+
+  // Announces that the calling thread holds no protected pointers, and frees
+  // what it retired that no reader can still see.
+  static void QuiescentState();
+  // An offline thread is not waited for, and must not read protected
+  // structures until it calls ThreadOnline().  For threads about to block.
+  static void ThreadOffline();
+  static void ThreadOnline();
+
+  // Calls |deleter| on |object| once no reader can still hold it.  Callable
+  // from any thread, registered or not.
+  static void Retire(void* object, void (*deleter)(void*));
+  template <typename T>
+  static void Delete(const T* object) {
+    Retire(const_cast<T*>(object), &DeleteObject<T>);
+  }
+
+private:
+  template <typename T>
+  static void DeleteObject(void* object) {
+    delete static_cast<T*>(object);
+  }
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(EpochReclaimer);
+};
+
+}  // namespace base
+
+#endif
@@ -0,0 +1,105 @@
+#include "base/epoch_reclaimer.h"
+
+#include <atomic>
+#include <map>
+
+#include "base/hazard_pointer.h"
+#include "base/lock.h"
+#include "base/rw_lock.h"
+#include "benchmark/benchmark.h"
+
+namespace base {
+
+namespace {
+
+typedef std::map<int, int> RouteMap;
+
+const int kRoutes = 64;
+// Thread 0 replaces the map once per this many reads of its own.
+const int kReadsPerWrite = 4096;
+// How often a reader announces a quiescent state, as a loop does between
+// tasks.
+const int kReadsPerQuiescentState = 64;
+
+RouteMap MakeRoutes() {
+  RouteMap routes;
+  for (int i = 0; i < kRoutes; ++i)
+    routes[i] = i;
+  return routes;
+}
+
+// Published maps, one per scheme.
+std::atomic<RouteMap*> g_epoch_routes(new RouteMap(MakeRoutes()));
+std::atomic<RouteMap*> g_hazard_routes(new RouteMap(MakeRoutes()));
+Lock g_writer_lock;
+
+RouteMap g_rw_routes(MakeRoutes());
+RWLock g_rw_lock;
+
+void PublishCopy(std::atomic<RouteMap*>* routes, int key, bool hazard) {
+  AutoLock locked(g_writer_lock);
+  RouteMap* updated = new RouteMap(*routes->load(std::memory_order_relaxed));
+  ++(*updated)[key];
+  RouteMap* old = routes->exchange(updated, std::memory_order_acq_rel);
+  if (hazard)
+    HazardPointer::Delete(old);
+  else
+    EpochReclaimer::Delete(old);
+}
+
+void BM_ReadMapEpoch(benchmark::State& state) {
+  EpochReclaimer::RegisterThread();
+  int key = 0;
+  int reads = 0;
+  for (auto _ : state) {
+    key = (key + 1) % kRoutes;
+    const RouteMap* routes = g_epoch_routes.load(std::memory_order_acquire);
+    benchmark::DoNotOptimize(routes->find(key)->second);
+    if (key % kReadsPerQuiescentState == 0)
+      EpochReclaimer::QuiescentState();
+    if (state.thread_index() == 0 && ++reads % kReadsPerWrite == 0)
+      PublishCopy(&g_epoch_routes, key, false);
+  }
+  EpochReclaimer::UnregisterThread();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ReadMapEpoch)->ThreadRange(1, 32)->UseRealTime();
+
+void BM_ReadMapHazardPointer(benchmark::State& state) {
+  HazardPointer hazard;
+  int key = 0;
+  int reads = 0;
+  for (auto _ : state) {
+    key = (key + 1) % kRoutes;
+    const RouteMap* routes = hazard.Protect(g_hazard_routes);
+    benchmark::DoNotOptimize(routes->find(key)->second);
+    hazard.Reset();
+    if (state.thread_index() == 0 && ++reads % kReadsPerWrite == 0)
+      PublishCopy(&g_hazard_routes, key, true);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ReadMapHazardPointer)->ThreadRange(1, 32)->UseRealTime();
+
+// The baseline: the map guarded by a reader-writer lock.
+void BM_ReadMapRWLock(benchmark::State& state) {
+  int key = 0;
+  int reads = 0;
+  for (auto _ : state) {
+    key = (key + 1) % kRoutes;
+    {
+      AutoReadLock locked(g_rw_lock);
+      benchmark::DoNotOptimize(g_rw_routes.find(key)->second);
+    }
+    if (state.thread_index() == 0 && ++reads % kReadsPerWrite == 0) {
+      AutoWriteLock locked(g_rw_lock);
+      ++g_rw_routes[key];
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ReadMapRWLock)->ThreadRange(1, 32)->UseRealTime();
+
+}  // namespace
+
+}  // namespace base
@@ -0,0 +1,135 @@
+#include "base/epoch_reclaimer.h"
+
+#include <atomic>
+
+#include "base/platform_thread.h"
+#include "base/time.h"
+#include "base/waitable_event.h"
+#include "gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+void SetFlag(void* flag) {
+  static_cast<std::atomic<bool>*>(flag)->store(true);
+}
+
+// Announces quiescent states until it is made to stop, or stays offline if
+// |offline|, so that each test controls when it lets retired objects go.
+class Reader {
+public:
+  explicit Reader(bool offline)
+    : offline_(offline)
+    , registered_(true, false)
+    , go_quiescent_(true, false)
+    , stop_(true, false)
+    , thread_() {
+    EXPECT_TRUE(PlatformThread::Create(&ThreadMain, this, &thread_));
+    EXPECT_TRUE(registered_.TimedWait(5000));
+  }
+
+  ~Reader() {
+    go_quiescent_.Signal();
+    stop_.Signal();
+    PlatformThread::Join(thread_);
+  }
+
+  void StartAnnouncingQuiescentStates() {
+    go_quiescent_.Signal();
+  }
+
+private:
+  static void ThreadMain(void* param) {
+    Reader* reader = static_cast<Reader*>(param);
+    EpochReclaimer::RegisterThread();
+    if (reader->offline_)
+      EpochReclaimer::ThreadOffline();
+    reader->registered_.Signal();
+    EXPECT_TRUE(reader->go_quiescent_.TimedWait(5000));
+    if (reader->offline_)
+      EpochReclaimer::ThreadOnline();
+    while (!reader->stop_.TimedWait(1))
+      EpochReclaimer::QuiescentState();
+    EpochReclaimer::UnregisterThread();
+  }
+
+  bool offline_;
+  WaitableEvent registered_;
+  WaitableEvent go_quiescent_;
+  WaitableEvent stop_;
+  PlatformThread::Handle thread_;
+};
+
+// Announces quiescent states on the calling thread until |flag| is set or
+// five seconds pass.
+bool QuiescentUntilSet(const std::atomic<bool>& flag) {
+  TimeTicks start = TickCount();
+  while (!flag.load()) {
+    if (TickCount() - start > 5000)
+      return false;
+    EpochReclaimer::QuiescentState();
+    PlatformThread::Sleep(1);
+  }
+  return true;
+}
+
+void RetireAndUnregister(void* flag) {
+  EpochReclaimer::RegisterThread();
+  EpochReclaimer::Retire(flag, &SetFlag);
+  EpochReclaimer::UnregisterThread();
+}
+
+}  // namespace
+
+TEST(EpochReclaimerTest, OnlineReaderHoldsRetiredObjectUntilQuiescent) {
+  std::atomic<bool> freed(false);
+  Reader reader(false);
+  EpochReclaimer::RegisterThread();
+  EpochReclaimer::Retire(&freed, &SetFlag);
+  for (int i = 0; i < 20; ++i) {
+    EpochReclaimer::QuiescentState();
+    PlatformThread::Sleep(1);
+  }
+  EXPECT_FALSE(freed.load());
+
+  reader.StartAnnouncingQuiescentStates();
+  EXPECT_TRUE(QuiescentUntilSet(freed));
+  EpochReclaimer::UnregisterThread();
+}
+
+TEST(EpochReclaimerTest, OfflineReaderDoesNotHoldRetiredObjects) {
+  std::atomic<bool> freed(false);
+  Reader reader(true);
+  EpochReclaimer::RegisterThread();
+  EpochReclaimer::Retire(&freed, &SetFlag);
+  EXPECT_TRUE(QuiescentUntilSet(freed));
+  EpochReclaimer::UnregisterThread();
+}
+
+TEST(EpochReclaimerTest, UnregisterThreadFreesWhatNoReaderCanSee) {
+  std::atomic<bool> freed(false);
+  PlatformThread::Handle thread;
+  ASSERT_TRUE(PlatformThread::Create(&RetireAndUnregister, &freed, &thread));
+  PlatformThread::Join(thread);
+  EXPECT_TRUE(freed.load());
+}
+
+TEST(EpochReclaimerTest, UnregisterThreadLeavesWhatAReaderCanSee) {
+  std::atomic<bool> freed(false);
+  {
+    Reader reader(false);
+    PlatformThread::Handle thread;
+    ASSERT_TRUE(PlatformThread::Create(&RetireAndUnregister, &freed, &thread));
+    PlatformThread::Join(thread);
+    EXPECT_FALSE(freed.load());
+
+    // Whoever reclaims next frees it once the reader lets it go.
+    reader.StartAnnouncingQuiescentStates();
+    EpochReclaimer::RegisterThread();
+    EXPECT_TRUE(QuiescentUntilSet(freed));
+    EpochReclaimer::UnregisterThread();
+  }
+}
+
+}  // namespace base
@@ -0,0 +1,100 @@
+#ifndef BASE_FUTEX_H_
+#define BASE_FUTEX_H_
+
+#include <atomic>
+
+#include "base/time.h"
+
+#if defined(OS_LINUX)
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace base {
+namespace internal {
+
+// Thin wrappers for sleeping on a process-private 32-bit word: the futex
+// syscall on Linux, WaitOnAddress on Windows.  Callers always re-check their
+// condition after waking up: a wait may return early on signals or
+// spuriously.
+
+#if defined(OS_WIN)
+
+// Blocks while |*word| == |expected|, until woken or until |timeout_ms|
+// passes.  Returns false only when the timeout expired.
+inline bool FutexWaitFor(std::atomic<int>* word, int expected,
+                         TimeDelta timeout_ms) {
+  if (::WaitOnAddress(word, &expected, sizeof(expected), timeout_ms))
+    return true;
+  return ::GetLastError() != ERROR_TIMEOUT;
+}
+
+inline void FutexWait(std::atomic<int>* word, int expected) {
+  ::WaitOnAddress(word, &expected, sizeof(expected), INFINITE);
+}
+
+inline void FutexWakeOne(std::atomic<int>* word) {
+  ::WakeByAddressSingle(word);
+}
+
+inline void FutexWakeAll(std::atomic<int>* word) {
+  ::WakeByAddressAll(word);
+}
+
+#elif defined(OS_LINUX)
+
+// Blocks while |*word| == |expected|, until woken or until the absolute
+// CLOCK_MONOTONIC |deadline| passes (NULL waits forever). Returns false only
+// when the deadline expired.
+inline bool FutexWaitUntil(std::atomic<int>* word, int expected,
+                           const struct timespec* deadline) {
+  long result = syscall(SYS_futex, reinterpret_cast<int*>(word),
+                        FUTEX_WAIT_BITSET_PRIVATE, expected, deadline,
+                        NULL, FUTEX_BITSET_MATCH_ANY);
+  return result == 0 || errno != ETIMEDOUT;
+}
+
+// Converts a relative timeout in milliseconds into a CLOCK_MONOTONIC deadline
+// suitable for FutexWaitUntil().
+inline struct timespec FutexDeadlineAfter(TimeDelta milliseconds) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += milliseconds / 1000;
+  deadline.tv_nsec += (milliseconds % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec += 1;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  return deadline;
+}
+
+inline bool FutexWaitFor(std::atomic<int>* word, int expected,
+                         TimeDelta timeout_ms) {
+  struct timespec deadline = FutexDeadlineAfter(timeout_ms);
+  return FutexWaitUntil(word, expected, &deadline);
+}
+
+inline void FutexWait(std::atomic<int>* word, int expected) {
+  FutexWaitUntil(word, expected, NULL);
+}
+
+inline void FutexWakeOne(std::atomic<int>* word) {
+  syscall(SYS_futex, reinterpret_cast<int*>(word), FUTEX_WAKE_PRIVATE, 1,
+          NULL, NULL, 0);
+}
+
+inline void FutexWakeAll(std::atomic<int>* word) {
+  syscall(SYS_futex, reinterpret_cast<int*>(word), FUTEX_WAKE_PRIVATE,
+          INT_MAX, NULL, NULL, 0);
+}
+
+#endif
+
+}  // namespace internal
+}  // namespace base
+
+#endif
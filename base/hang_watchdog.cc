@@ -0,0 +1,204 @@
+#include "base/hang_watchdog.h"
+
+#include "base/lock.h"
+#include "base/platform_thread.h"
+#include "base/waitable_event.h"
+
+namespace base {
+
+namespace {
+
+// How often the watchdog looks at each thread, relative to the threshold.
+const TimeDelta kPollsPerThreshold = 4;
+const TimeDelta kMinPollIntervalMs = 10;
+
+// Never a stable Watch version, which is even.
+const unsigned kNoVersion = 1;
+
+struct WatchdogState {
+  WatchdogState()
+    : threshold_ms(0)
+    , running(false)
+    , thread()
+    , stop_event(true, false) {
+  }
+
+  // Held while watched threads are sampled, so that their Watches outlive
+  // the samples.  Taken before |lock|, never inside it.
+  Lock sampling_lock;
+  Lock lock;
+  // Guarded by |lock|.
+  std::vector<HangWatchdog::Watch*> watches;
+  std::vector<HangReport> reports;
+  TimeDelta threshold_ms;
+  bool running;
+  PlatformThread::Handle thread;
+  WaitableEvent stop_event;
+};
+
+// Leaked so that loops can unregister during static destruction.
+WatchdogState* GetState() {
+  static WatchdogState* state = new WatchdogState();
+  return state;
+}
+
+TimeDelta PollIntervalMs(TimeDelta threshold_ms) {
+  TimeDelta interval_ms = threshold_ms / kPollsPerThreshold;
+  return interval_ms < kMinPollIntervalMs ? kMinPollIntervalMs : interval_ms;
+}
+
+}  // namespace
+
+HangReport::HangReport()
+  : thread_name(NULL)
+  , hung_ms(0)
+  , frame_count(0) {
+}
+
+HangWatchdog::Watch::Watch(const char* thread_name)
+  : thread_name_(thread_name)
+  , version_(0)
+  , function_name_(NULL)
+  , file_name_(NULL)
+  , line_(0)
+  , running_(false)
+  , seen_version_(kNoVersion)
+  , seen_since_ns_(0)
+  , reported_(false) {
+  WatchdogState* state = GetState();
+  AutoLock locked(state->lock);
+  state->watches.push_back(this);
+}
+
+bool HangWatchdog::Watch::GetRunningTask(Location* posted_from,
+  unsigned* task_version) const {
+  if (!running_.load(std::memory_order_acquire))
+    return false;
+  unsigned version = version_.load(std::memory_order_acquire);
+  Location location(function_name_.load(std::memory_order_relaxed),
+    file_name_.load(std::memory_order_relaxed),
+    line_.load(std::memory_order_relaxed));
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (version % 2 || version_.load(std::memory_order_relaxed) != version)
+    return false;
+  *posted_from = location;
+  *task_version = version;
+  return true;
+}
+
+HangWatchdog::Watch::~Watch() {
+  WatchdogState* state = GetState();
+  AutoLock sampling(state->sampling_lock);
+  AutoLock locked(state->lock);
+  for (size_t i = 0; i < state->watches.size(); ++i) {
+    if (state->watches[i] == this) {
+      state->watches.erase(state->watches.begin() + i);
+      break;
+    }
+  }
+}
+
+// static
+void HangWatchdog::ThreadMain(void* /* param */) {
+  WatchdogState* state = GetState();
+  TimeDelta interval_ms = PollIntervalMs(state->threshold_ms);
+  while (!state->stop_event.TimedWait(interval_ms))
+    CheckWatches();
+}
+
+// static
+void HangWatchdog::Start(TimeDelta threshold_ms) {
+  WatchdogState* state = GetState();
+  AutoLock locked(state->lock);
+  if (state->running)
+    return;
+  state->threshold_ms = threshold_ms;
+  state->stop_event.Reset();
+  if (!PlatformThread::Create(&ThreadMain, NULL, &state->thread))
+    return;
+  state->running = true;
+}
+
+// static
+void HangWatchdog::Stop() {
+  WatchdogState* state = GetState();
+  {
+    AutoLock locked(state->lock);
+    if (!state->running)
+      return;
+    state->running = false;
+  }
+  // The watchdog takes the lock on every poll.
+  state->stop_event.Signal();
+  PlatformThread::Join(state->thread);
+}
+
+// static
+std::vector<HangReport> HangWatchdog::GetReports() {
+  WatchdogState* state = GetState();
+  AutoLock locked(state->lock);
+  return state->reports;
+}
+
+// static
+void HangWatchdog::ForEachWatch(void (*visit)(Watch* watch, void* context),
+  void* context) {
+  WatchdogState* state = GetState();
+  AutoLock sampling(state->sampling_lock);
+  std::vector<Watch*> watches;
+  {
+    AutoLock locked(state->lock);
+    watches = state->watches;
+  }
+  for (size_t i = 0; i < watches.size(); ++i)
+    visit(watches[i], context);
+}
+
+// static
+void HangWatchdog::CheckWatches() {
+  WatchdogState* state = GetState();
+  long long now = MonotonicNanoseconds();
+  AutoLock sampling(state->sampling_lock);
+  std::vector<Watch*> hung_watches;
+  std::vector<HangReport> reports;
+  {
+    AutoLock locked(state->lock);
+    long long threshold_ns = state->threshold_ms * 1000000LL;
+    for (size_t i = 0; i < state->watches.size(); ++i) {
+      Watch* watch = state->watches[i];
+      Location posted_from;
+      unsigned version;
+      // Idle, or a task is starting; look again on the next poll.
+      if (!watch->GetRunningTask(&posted_from, &version))
+        continue;
+      if (version != watch->seen_version_) {
+        watch->seen_version_ = version;
+        watch->seen_since_ns_ = now;
+        watch->reported_ = false;
+        continue;
+      }
+      if (watch->reported_ || now - watch->seen_since_ns_ < threshold_ns)
+        continue;
+      watch->reported_ = true;
+      if (state->reports.size() + reports.size() >= kMaxReports)
+        continue;
+      HangReport report;
+      report.thread_name = watch->thread_name_;
+      report.posted_from = posted_from;
+      report.hung_ms = (now - watch->seen_since_ns_) / 1000000;
+      hung_watches.push_back(watch);
+      reports.push_back(report);
+    }
+  }
+
+  // Sampled without |lock|, which threads take to start and exit, and which
+  // a suspended thread may be waiting for.
+  for (size_t i = 0; i < reports.size(); ++i) {
+    reports[i].frame_count = hung_watches[i]->sampler_.Sample(reports[i].frames,
+      StackSampler::kMaxFrames);
+  }
+  AutoLock locked(state->lock);
+  state->reports.insert(state->reports.end(), reports.begin(), reports.end());
+}
+
+}  // namespace base
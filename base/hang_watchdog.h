@@ -0,0 +1,112 @@
+#ifndef BASE_HANG_WATCHDOG_H_
+#define BASE_HANG_WATCHDOG_H_
+
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+#include "base/location.h"
+#include "base/stack_sampler.h"
+#include "base/time.h"
+
+namespace base {
+
+struct BASE_EXPORT HangReport {
+  HangReport();
+  const char* thread_name;
+  // Where the hung task was posted from.
+  Location posted_from;
+  // How long the task had run when its thread was sampled, give or take
+  // one poll of the watchdog.
+  long long hung_ms;
+  // The hung thread's stack, innermost frame first.
+  const void* frames[StackSampler::kMaxFrames];
+  size_t frame_count;
+};
+
+// Watches threads that run tasks, such as MessageLoops, from a thread of its
+// own, and records a report for every task that runs past a threshold: where
+// it was posted from, and a stack sample of its thread taken while it is
+// still stuck.  Each hung task is reported once.
+//
+// A watched thread only publishes which task it is running, with a few
+// plain stores per task.  The watchdog reads the clock itself when it
+// first sees a task, so the task path makes no system calls.
+class BASE_EXPORT HangWatchdog {
+public:
+  static const size_t kMaxReports = 16;
+
+  // The state of one watched thread.  Constructed on that thread, which
+  // then brackets each task with TaskStarted() and TaskFinished().
+  class BASE_EXPORT Watch {
+  public:
+    // |thread_name| must outlive the watch.
+    explicit Watch(const char* thread_name);
+    ~Watch();
+
+    void TaskStarted(const Location& posted_from) {
+      unsigned version = version_.load(std::memory_order_relaxed);
+      version_.store(version + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      function_name_.store(posted_from.function_name(), std::memory_order_relaxed);
+      file_name_.store(posted_from.file_name(), std::memory_order_relaxed);
+      line_.store(posted_from.line(), std::memory_order_relaxed);
+      version_.store(version + 2, std::memory_order_release);
+      running_.store(true, std::memory_order_release);
+    }
+    void TaskFinished() {
+      running_.store(false, std::memory_order_relaxed);
+    }
+
+    // Reads, from any thread, where the running task was posted from, and a
+    // number that differs between tasks.  Returns false if the thread is
+    // idle or in the middle of starting a task.
+    bool GetRunningTask(Location* posted_from, unsigned* task_version) const;
+
+    const char* thread_name() const { return thread_name_; }
+    StackSampler* sampler() { return &sampler_; }
+
+  private:
+    friend class HangWatchdog;
+
+    const char* thread_name_;
+    StackSampler sampler_;
+    // Odd while TaskStarted() rewrites the location below, so the watchdog
+    // can tell a torn read.  Written by the watched thread only.
+    std::atomic<unsigned> version_;
+    std::atomic<const char*> function_name_;
+    std::atomic<const char*> file_name_;
+    std::atomic<int> line_;
+    std::atomic<bool> running_;
+    // Watchdog thread only.
+    unsigned seen_version_;
+    long long seen_since_ns_;
+    bool reported_;
+
+    DISALLOW_COPY_AND_ASSIGN(Watch);
+  };
+
+  // Starts the watchdog thread, reporting tasks that run for |threshold_ms|
+  // or longer.  Does nothing if it is already running.
+  static void Start(TimeDelta threshold_ms);
+  // Stops the watchdog thread and waits for it to exit.
+  static void Stop();
+  // The first kMaxReports hangs recorded since the process started.
+  static std::vector<HangReport> GetReports();
+
+  // Calls |visit| on every watched thread.  No Watch can be destroyed
+  // meanwhile, so |visit| must not destroy one; threads that start meanwhile
+  // are not visited.
+  static void ForEachWatch(void (*visit)(Watch* watch, void* context),
+    void* context);
+
+private:
+  static void ThreadMain(void* param);
+  static void CheckWatches();
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(HangWatchdog);
+};
+
+}  // namespace base
+
+#endif
@@ -0,0 +1,55 @@
+#include "base/hang_watchdog.h"
+
+#include <string.h>
+
+#include "base/closure.h"
+#include "base/message_loop.h"
+#include "base/platform_thread.h"
+#include "base/waitable_event.h"
+#include "gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+void Hang(TimeDelta duration_ms, WaitableEvent* done) {
+  PlatformThread::Sleep(duration_ms);
+  done->Signal();
+}
+
+}  // namespace
+
+TEST(HangWatchdogTest, ReportsLongTaskWithWhereItWasPostedAndItsStack) {
+  HangWatchdog::Start(50);
+  MessageLoop::StartLazily(MessageLoop::IO);
+  Location posted_from = FROM_HERE;
+  WaitableEvent done(true, false);
+  MessageLoop::PostTask(posted_from, MessageLoop::IO, Bind(&Hang, 400, &done));
+  EXPECT_TRUE(done.TimedWait(5000));
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::IO, 5000, NULL));
+  HangWatchdog::Stop();
+
+  std::vector<HangReport> reports = HangWatchdog::GetReports();
+  ASSERT_EQ(1u, reports.size());
+  EXPECT_STREQ("IO", reports[0].thread_name);
+  EXPECT_EQ(posted_from.line(), reports[0].posted_from.line());
+  EXPECT_GE(reports[0].hung_ms, 50);
+  EXPECT_GT(reports[0].frame_count, 0u);
+}
+
+TEST(HangWatchdogTest, IgnoresShortTasks) {
+  // Reports are kept for the life of the process.
+  size_t reports_before = HangWatchdog::GetReports().size();
+  HangWatchdog::Start(200);
+  MessageLoop::StartLazily(MessageLoop::IO);
+  WaitableEvent done(false, false);
+  for (int i = 0; i < 10; ++i) {
+    MessageLoop::PostTask(MessageLoop::IO, Bind(&Hang, 10, &done));
+    EXPECT_TRUE(done.TimedWait(5000));
+  }
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::IO, 5000, NULL));
+  HangWatchdog::Stop();
+  EXPECT_EQ(reports_before, HangWatchdog::GetReports().size());
+}
+
+}  // namespace base
@@ -0,0 +1,135 @@
+#include "base/hazard_pointer.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/lock.h"
+
+namespace base {
+
+namespace {
+
+// Objects a thread retires before it scans the slots for ones it can free.
+const size_t kScanThreshold = 64;
+
+struct RetiredObject {
+  void* object;
+  void (*deleter)(void*);
+};
+
+std::atomic<internal::HazardSlot*> g_slots(NULL);
+
+// Objects retired by threads that have exited, freed by the next scan.
+struct Orphans {
+  Lock lock;
+  std::vector<RetiredObject> objects;
+};
+
+// Leaked so that objects can still be retired during static destruction.
+Orphans* GetOrphans() {
+  static Orphans* orphans = new Orphans();
+  return orphans;
+}
+
+void AddOrphans(const std::vector<RetiredObject>& objects) {
+  Orphans* orphans = GetOrphans();
+  AutoLock locked(orphans->lock);
+  orphans->objects.insert(orphans->objects.end(), objects.begin(), objects.end());
+}
+
+// Frees the objects in |retired| that no slot holds and keeps the rest.
+void Scan(std::vector<RetiredObject>* retired) {
+  std::vector<RetiredObject> candidates;
+  candidates.swap(*retired);
+  Orphans* orphans = GetOrphans();
+  if (orphans->lock.Try()) {
+    AutoLock locked(orphans->lock, AutoLock::AlreadyAcquired());
+    candidates.insert(candidates.end(), orphans->objects.begin(), orphans->objects.end());
+    orphans->objects.clear();
+  }
+
+  // Pairs with the fence in Protect(): a reader either published its
+  // pointer before this point or will find the object unlinked.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  std::vector<const void*> hazards;
+  for (internal::HazardSlot* slot = g_slots.load(std::memory_order_acquire); slot;
+    slot = slot->next) {
+    const void* pointer = slot->pointer.load(std::memory_order_acquire);
+    if (pointer)
+      hazards.push_back(pointer);
+  }
+  std::sort(hazards.begin(), hazards.end());
+
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (std::binary_search(hazards.begin(), hazards.end(), candidates[i].object))
+      retired->push_back(candidates[i]);
+    else
+      candidates[i].deleter(candidates[i].object);
+  }
+}
+
+struct RetiredList {
+  ~RetiredList();
+
+  std::vector<RetiredObject> objects;
+};
+
+// Set once this thread's list has been destroyed at thread exit; objects
+// retired after that are orphaned straight away.
+thread_local bool t_list_destroyed = false;
+
+RetiredList::~RetiredList() {
+  Scan(&objects);
+  if (!objects.empty())
+    AddOrphans(objects);
+  t_list_destroyed = true;
+}
+
+RetiredList* GetRetiredList() {
+  if (t_list_destroyed)
+    return NULL;
+  static thread_local RetiredList list;
+  return &list;
+}
+
+}  // namespace
+
+HazardPointer::HazardPointer() : slot_(NULL) {
+  for (internal::HazardSlot* slot = g_slots.load(std::memory_order_acquire); slot;
+    slot = slot->next) {
+    bool in_use = false;
+    if (!slot->in_use.load(std::memory_order_relaxed) &&
+      slot->in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire)) {
+      slot_ = slot;
+      return;
+    }
+  }
+  slot_ = new internal::HazardSlot();
+  slot_->pointer.store(NULL, std::memory_order_relaxed);
+  slot_->in_use.store(true, std::memory_order_relaxed);
+  internal::HazardSlot* head = g_slots.load(std::memory_order_relaxed);
+  do {
+    slot_->next = head;
+  } while (!g_slots.compare_exchange_weak(head, slot_,
+    std::memory_order_release, std::memory_order_relaxed));
+}
+
+HazardPointer::~HazardPointer() {
+  Reset();
+  slot_->in_use.store(false, std::memory_order_release);
+}
+
+// static
+void HazardPointer::Retire(void* object, void (*deleter)(void*)) {
+  RetiredObject retired = { object, deleter };
+  RetiredList* list = GetRetiredList();
+  if (!list) {
+    AddOrphans(std::vector<RetiredObject>(1, retired));
+    return;
+  }
+  list->objects.push_back(retired);
+  if (list->objects.size() >= kScanThreshold)
+    Scan(&list->objects);
+}
+
+}  // namespace base
@@ -0,0 +1,77 @@
+#ifndef BASE_HAZARD_POINTER_H_
+#define BASE_HAZARD_POINTER_H_
+
+#include <stddef.h>
+#include <atomic>
+
+namespace base {
+
+namespace internal {
+
+// One published pointer.  Slots are never freed, only reused.
+struct HazardSlot {
+  std::atomic<const void*> pointer;
+  std::atomic<bool> in_use;
+  // Set before the slot is published and never changed afterwards.
+  HazardSlot* next;
+};
+
+}  // namespace internal
+
+// Protects single objects of a lock-free structure for threads that cannot
+// announce quiescent states to EpochReclaimer, e.g. ones that block in
+// third-party code.  A reader publishes the pointer it is about to use, and
+// Retire() frees an object only once no hazard pointer holds it.  Every
+// Protect() costs a store and a full fence, so MessageLoop threads should
+// use EpochReclaimer instead.
+//
+//   base::HazardPointer hazard;
+//   const Config* config = hazard.Protect(g_config);
+//   Apply(*config);
+//   hazard.Reset();
+class BASE_EXPORT HazardPointer {
+public:
+  HazardPointer();
+  ~HazardPointer();
+
+  // Loads |source| and keeps the object it points to alive until Reset(),
+  // the next Protect() or destruction.
+  template <typename T>
+  T* Protect(const std::atomic<T*>& source) {
+    T* object = source.load(std::memory_order_relaxed);
+    for (;;) {
+      slot_->pointer.store(object, std::memory_order_seq_cst);
+      // Still reachable after publishing, so not retired before it.
+      T* current = source.load(std::memory_order_acquire);
+      if (current == object)
+        return object;
+      object = current;
+    }
+  }
+
+  void Reset() {
+    slot_->pointer.store(NULL, std::memory_order_release);
+  }
+
+  // Calls |deleter| on |object| once no hazard pointer holds it.  |object|
+  // must already be unreachable from the structure.
+  static void Retire(void* object, void (*deleter)(void*));
+  template <typename T>
+  static void Delete(const T* object) {
+    Retire(const_cast<T*>(object), &DeleteObject<T>);
+  }
+
+private:
+  template <typename T>
+  static void DeleteObject(void* object) {
+    delete static_cast<T*>(object);
+  }
+
+  internal::HazardSlot* slot_;
+
+  DISALLOW_COPY_AND_ASSIGN(HazardPointer);
+};
+
+}  // namespace base
+
+#endif
@@ -0,0 +1,77 @@
+#include "base/hazard_pointer.h"
+
+#include <atomic>
+
+#include "base/platform_thread.h"
+#include "gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// Objects a thread can retire without triggering a scan of the slots.
+const int kBelowScanThreshold = 8;
+// Enough to make the retiring thread scan at least once.
+const int kPastScanThreshold = 200;
+
+struct Tracked {
+  explicit Tracked(std::atomic<int>* frees) : frees(frees) {}
+  ~Tracked() { frees->fetch_add(1); }
+
+  std::atomic<int>* frees;
+};
+
+struct RetireParams {
+  std::atomic<Tracked*>* source;
+  std::atomic<int>* frees;
+  int filler_count;
+};
+
+// Unlinks the object in |source| and retires it along with
+// |filler_count| unprotected ones, then exits.
+void RetireFromOtherThread(void* param) {
+  RetireParams* params = static_cast<RetireParams*>(param);
+  if (params->source)
+    HazardPointer::Delete(params->source->exchange(NULL));
+  for (int i = 0; i < params->filler_count; ++i)
+    HazardPointer::Delete(new Tracked(params->frees));
+}
+
+void RunOnThread(RetireParams* params) {
+  PlatformThread::Handle thread;
+  ASSERT_TRUE(PlatformThread::Create(&RetireFromOtherThread, params, &thread));
+  PlatformThread::Join(thread);
+}
+
+}  // namespace
+
+TEST(HazardPointerTest, ProtectedObjectOutlivesRetire) {
+  std::atomic<int> protected_frees(0);
+  std::atomic<int> filler_frees(0);
+  std::atomic<Tracked*> source(new Tracked(&protected_frees));
+
+  HazardPointer hazard;
+  Tracked* object = hazard.Protect(source);
+  ASSERT_TRUE(object);
+  RetireParams params = { &source, &filler_frees, kPastScanThreshold };
+  RunOnThread(&params);
+  // Scanned both past the threshold and at thread exit.
+  EXPECT_EQ(kPastScanThreshold, filler_frees.load());
+  EXPECT_EQ(0, protected_frees.load());
+  EXPECT_EQ(&protected_frees, object->frees);
+
+  // Left to the next scan, by any thread.
+  hazard.Reset();
+  RetireParams next_params = { NULL, &filler_frees, kPastScanThreshold };
+  RunOnThread(&next_params);
+  EXPECT_EQ(1, protected_frees.load());
+}
+
+TEST(HazardPointerTest, RetiredObjectsFreedAtThreadExit) {
+  std::atomic<int> frees(0);
+  RetireParams params = { NULL, &frees, kBelowScanThreshold };
+  RunOnThread(&params);
+  EXPECT_EQ(kBelowScanThreshold, frees.load());
+}
+
+}  // namespace base
@@ -0,0 +1,155 @@
+#include "base/histogram.h"
+
+#include <assert.h>
+#include <math.h>
+#include <new>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "base/counter.h"
+
+namespace base {
+
+namespace {
+
+// |value| must not be 0.
+int MostSignificantBit(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+#if defined(_WIN64)
+  _BitScanReverse64(&index, value);
+  return static_cast<int>(index);
+#else
+  if (_BitScanReverse(&index, static_cast<unsigned long>(value >> 32)))
+    return static_cast<int>(index) + 32;
+  _BitScanReverse(&index, static_cast<unsigned long>(value));
+  return static_cast<int>(index);
+#endif
+#else
+  return 63 - __builtin_clzll(value);
+#endif
+}
+
+// One shard per hardware thread, so that each core records into its own.
+size_t ComputeShardCount() {
+  size_t hardware_threads = std::thread::hardware_concurrency();
+  if (!hardware_threads)
+    return 1;
+  return hardware_threads < Histogram::kMaxShards ? hardware_threads
+                                                 : Histogram::kMaxShards;
+}
+
+size_t HistogramShardCount() {
+  static const size_t shard_count = ComputeShardCount();
+  return shard_count;
+}
+
+}  // namespace
+
+Histogram::Snapshot::Snapshot()
+  : counts_(kBucketCount, 0)
+  , count_(0)
+  , sum_(0) {
+}
+
+void Histogram::Snapshot::Merge(const Snapshot& other) {
+  for (size_t i = 0; i < kBucketCount; ++i)
+    counts_[i] += other.counts_[i];
+  count_ += other.count_;
+  sum_ += other.sum_;
+}
+
+double Histogram::Snapshot::Mean() const {
+  return count_ ? static_cast<double>(sum_) / count_ : 0;
+}
+
+uint64_t Histogram::Snapshot::Percentile(double percentile) const {
+  if (!count_)
+    return 0;
+  if (percentile < 0)
+    percentile = 0;
+  if (percentile > 100)
+    percentile = 100;
+  uint64_t rank = static_cast<uint64_t>(ceil(percentile / 100 * count_));
+  if (rank == 0)
+    rank = 1;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    seen += counts_[i];
+    if (seen >= rank)
+      return BucketUpperBound(i);
+  }
+  return BucketUpperBound(kBucketCount - 1);
+}
+
+Histogram::Histogram()
+  : shard_storage_(NULL)
+  , shards_(NULL)
+  , shard_count_(HistogramShardCount()) {
+  shard_storage_ = new char[shard_count_ * sizeof(Shard) + alignof(Shard) - 1];
+  uintptr_t address = reinterpret_cast<uintptr_t>(shard_storage_);
+  address = (address + alignof(Shard) - 1) & ~(uintptr_t(alignof(Shard)) - 1);
+  shards_ = reinterpret_cast<Shard*>(address);
+  for (size_t shard = 0; shard < shard_count_; ++shard) {
+    new (&shards_[shard]) Shard;
+    for (size_t i = 0; i < kBucketCount; ++i)
+      shards_[shard].counts[i].store(0, std::memory_order_relaxed);
+    shards_[shard].sum.store(0, std::memory_order_relaxed);
+  }
+}
+
+Histogram::~Histogram() {
+  // Shard is trivially destructible.
+  delete[] shard_storage_;
+}
+
+void Histogram::Record(uint64_t value) {
+  Shard& shard = shards_[internal::ThreadShardIndex(shard_count_)];
+  shard.counts[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::GetSnapshot() const {
+  Snapshot snapshot;
+  for (size_t shard = 0; shard < shard_count_; ++shard) {
+    for (size_t i = 0; i < kBucketCount; ++i) {
+      uint64_t count = shards_[shard].counts[i].load(std::memory_order_relaxed);
+      snapshot.counts_[i] += count;
+      snapshot.count_ += count;
+    }
+    snapshot.sum_ += shards_[shard].sum.load(std::memory_order_relaxed);
+  }
+  return snapshot;
+}
+
+// static
+size_t Histogram::BucketIndex(uint64_t value) {
+  if (value < kSubBuckets)
+    return static_cast<size_t>(value);
+  int exponent = MostSignificantBit(value);
+  size_t sub_bucket =
+    static_cast<size_t>(value >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+  return (exponent - kSubBucketBits + 1) * kSubBuckets + sub_bucket;
+}
+
+// static
+uint64_t Histogram::BucketLowerBound(size_t index) {
+  assert(index < kBucketCount);
+  if (index < kSubBuckets)
+    return index;
+  int shift = static_cast<int>(index / kSubBuckets) - 1;
+  return static_cast<uint64_t>(kSubBuckets + index % kSubBuckets) << shift;
+}
+
+// static
+uint64_t Histogram::BucketUpperBound(size_t index) {
+  if (index < kSubBuckets)
+    return index;
+  int shift = static_cast<int>(index / kSubBuckets) - 1;
+  return BucketLowerBound(index) + ((static_cast<uint64_t>(1) << shift) - 1);
+}
+
+}  // namespace base
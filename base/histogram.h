@@ -0,0 +1,85 @@
+#ifndef BASE_HISTOGRAM_H_
+#define BASE_HISTOGRAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+namespace base {
+
+// A lock-free histogram of non-negative integer samples, such as latencies
+// in microseconds or queue lengths.  Buckets are HDR-style: values below 8
+// get a bucket each, and every power of two above that is split into 8
+// linear sub-buckets, so a reported value is within 12.5% of the recorded
+// one over the whole 64-bit range.
+//
+// Record() is a relaxed increment on one of shard_count() copies of the
+// buckets, picked by the calling thread.  There is a copy per hardware
+// thread, up to kMaxShards, each on cache lines of its own, so threads
+// recording at once rarely touch the same line.  Read the samples with
+// GetSnapshot().
+class BASE_EXPORT Histogram {
+public:
+  static const int kSubBucketBits = 3;
+  static const size_t kSubBuckets = 1 << kSubBucketBits;
+  static const size_t kBucketCount = (64 - kSubBucketBits + 1) * kSubBuckets;
+  static const size_t kMaxShards = 32;
+
+  // A copy of the samples at one point in time.  Snapshots of several
+  // histograms, e.g. one per loop, can be merged into one.
+  class BASE_EXPORT Snapshot {
+  public:
+    Snapshot();
+
+    void Merge(const Snapshot& other);
+
+    uint64_t count() const { return count_; }
+    uint64_t sum() const { return sum_; }
+    double Mean() const;
+
+    // The value that |percentile| percent (0 to 100) of the samples are at
+    // or below, rounded up to the end of its bucket; 0 if there are none.
+    uint64_t Percentile(double percentile) const;
+    uint64_t Max() const { return Percentile(100); }
+
+  private:
+    friend class Histogram;
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    uint64_t sum_;
+  };
+
+  Histogram();
+  ~Histogram();
+
+  void Record(uint64_t value);
+
+  Snapshot GetSnapshot() const;
+
+  static size_t BucketIndex(uint64_t value);
+  // The smallest and largest values recorded into bucket |index|.
+  static uint64_t BucketLowerBound(size_t index);
+  static uint64_t BucketUpperBound(size_t index);
+
+  size_t shard_count() const { return shard_count_; }
+
+private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> counts[kBucketCount];
+    std::atomic<uint64_t> sum;
+  };
+
+  // operator new does not honor the alignment of Shard before C++17, so the
+  // shards are placed in |shard_storage_| by hand.
+  char* shard_storage_;
+  Shard* shards_;
+  size_t shard_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(Histogram);
+};
+
+}  // namespace base
+
+#endif
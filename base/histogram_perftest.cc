@@ -0,0 +1,31 @@
+#include "base/histogram.h"
+
+#include <atomic>
+
+#include "benchmark/benchmark.h"
+
+namespace base {
+
+namespace {
+
+Histogram g_histogram;
+
+// What every thread recording into one set of buckets would cost.
+std::atomic<uint64_t> g_shared_bucket(0);
+
+void BM_HistogramRecord(benchmark::State& state) {
+  uint64_t value = state.thread_index();
+  for (auto _ : state)
+    g_histogram.Record(++value & 1023);
+}
+BENCHMARK(BM_HistogramRecord)->ThreadRange(1, 32)->UseRealTime();
+
+void BM_SharedAtomicIncrement(benchmark::State& state) {
+  for (auto _ : state)
+    g_shared_bucket.fetch_add(1, std::memory_order_relaxed);
+}
+BENCHMARK(BM_SharedAtomicIncrement)->ThreadRange(1, 32)->UseRealTime();
+
+}  // namespace
+
+}  // namespace base
@@ -0,0 +1,25 @@
+#include "base/location.h"
+
+#include <stdio.h>
+
+namespace base {
+
+Location::Location()
+  : function_name_("unknown")
+  , file_name_("unknown")
+  , line_(-1) {
+}
+
+Location::Location(const char* function_name, const char* file_name, int line)
+  : function_name_(function_name)
+  , file_name_(file_name)
+  , line_(line) {
+}
+
+std::string Location::ToString() const {
+  char line[16];
+  snprintf(line, sizeof(line), "%d", line_);
+  return std::string(function_name_) + "@" + file_name_ + ":" + line;
+}
+
+}  // namespace base
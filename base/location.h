@@ -0,0 +1,33 @@
+#ifndef BASE_LOCATION_H_
+#define BASE_LOCATION_H_
+
+#include <string>
+
+namespace base {
+
+// Where a task was posted from, recorded with FROM_HERE.  Holds pointers to
+// string literals only, so it is cheap to copy into every task.
+class BASE_EXPORT Location {
+public:
+  // An unknown location, for tasks posted without FROM_HERE.
+  Location();
+  Location(const char* function_name, const char* file_name, int line);
+
+  const char* function_name() const { return function_name_; }
+  const char* file_name() const { return file_name_; }
+  int line() const { return line_; }
+
+  // "function@file:line".
+  std::string ToString() const;
+
+private:
+  const char* function_name_;
+  const char* file_name_;
+  int line_;
+};
+
+}  // namespace base
+
+#define FROM_HERE base::Location(__FUNCTION__, __FILE__, __LINE__)
+
+#endif
@@ -2,34 +2,233 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
-// This file is used for debugging assertion support.  The Lock class
-// is functionally a wrapper around the LockImpl class, so the only
-// real intelligence in the class is in the debugging logic.
 #include "base/lock.h"
 
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "base/futex.h"
+#include "base/time.h"
+
 namespace base {
 
-Lock::Lock() {
-  ::InitializeCriticalSectionAndSpinCount(&native_handle_, 2000);
+namespace internal {
+
+// Per-lock contention statistics.  The counters are only updated by the
+// thread holding the lock, so they need no read-modify-write operations; they
+// are atomics only so DumpContentionStats() can read them at any time.
+struct LockStats {
+  explicit LockStats(const char* name)
+    : name(name)
+    , acquire_count(0)
+    , contended_count(0)
+    , total_wait_ns(0)
+    , max_hold_ns(0)
+    , acquired_at(0)
+    , next(NULL)
+    , prev(NULL) {
+  }
+
+  const char* name;
+  std::atomic<long long> acquire_count;
+  std::atomic<long long> contended_count;
+  std::atomic<long long> total_wait_ns;
+  std::atomic<long long> max_hold_ns;
+  // When the current holder took the lock, or 0 if it was taken while
+  // recording was off.
+  long long acquired_at;
+
+  // Links in the list of named locks.
+  LockStats* next;
+  LockStats* prev;
+};
+
+}  // namespace internal
+
+namespace {
+
+const int kUnlocked = 0;
+const int kLocked = 1;
+const int kLockedWithWaiters = 2;
+
+// Bounds for the adaptive spin in AcquireContended().
+const int kMinSpins = 10;
+const int kMaxSpins = 200;
+
+std::atomic<bool> g_stats_enabled(false);
+
+// The registry of named locks.  Its lock is leaked and unnamed so that named
+// globals can still unregister during static destruction.
+Lock* RegistryLock() {
+  static Lock* lock = new Lock();
+  return lock;
+}
+internal::LockStats* g_named_locks = NULL;
+
+inline void CpuRelax() {
+#if defined(OS_WIN)
+  YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+inline void Increment(std::atomic<long long>* counter, long long delta) {
+  counter->store(counter->load(std::memory_order_relaxed) + delta,
+                 std::memory_order_relaxed);
+}
+
+bool HotterLock(const internal::LockStats* a, const internal::LockStats* b) {
+  return a->total_wait_ns.load(std::memory_order_relaxed) >
+         b->total_wait_ns.load(std::memory_order_relaxed);
+}
+
+}  // namespace
+
+Lock::Lock()
+    : state_(kUnlocked),
+      spin_estimate_(0),
+      stats_(NULL) {
+}
+
+Lock::Lock(const char* name)
+    : state_(kUnlocked),
+      spin_estimate_(0),
+      stats_(new internal::LockStats(name)) {
+  AutoLock locked(*RegistryLock());
+  stats_->next = g_named_locks;
+  if (g_named_locks)
+    g_named_locks->prev = stats_;
+  g_named_locks = stats_;
 }
 
 Lock::~Lock() {
-  ::DeleteCriticalSection(&native_handle_);
+  if (stats_) {
+    AutoLock locked(*RegistryLock());
+    if (stats_->prev)
+      stats_->prev->next = stats_->next;
+    else
+      g_named_locks = stats_->next;
+    if (stats_->next)
+      stats_->next->prev = stats_->prev;
+    delete stats_;
+  }
 }
 
 void Lock::Acquire() {
-  ::EnterCriticalSection(&native_handle_);
+  if (stats_ && g_stats_enabled.load(std::memory_order_relaxed)) {
+    AcquireWithStats();
+    return;
+  }
+  int expected = kUnlocked;
+  if (!state_.compare_exchange_strong(expected, kLocked,
+                                      std::memory_order_acquire,
+                                      std::memory_order_relaxed))
+    AcquireContended();
 }
 
 void Lock::Release() {
-  ::LeaveCriticalSection(&native_handle_);
+  if (stats_ && stats_->acquired_at)
+    ReleaseWithStats();
+  if (state_.exchange(kUnlocked, std::memory_order_release) ==
+      kLockedWithWaiters)
+    internal::FutexWakeOne(&state_);
 }
 
 bool Lock::Try() {
-  if (::TryEnterCriticalSection(&native_handle_) != FALSE) {
-    return true;
+  int expected = kUnlocked;
+  if (!state_.compare_exchange_strong(expected, kLocked,
+                                      std::memory_order_acquire,
+                                      std::memory_order_relaxed))
+    return false;
+  if (stats_ && g_stats_enabled.load(std::memory_order_relaxed)) {
+    Increment(&stats_->acquire_count, 1);
+    stats_->acquired_at = MonotonicNanoseconds();
+  }
+  return true;
+}
+
+void Lock::AcquireContended() {
+  // Spin for about as long as recent contended acquisitions needed, moving
+  // the estimate toward what this attempt took (the full limit if spinning
+  // failed), much like glibc's adaptive mutexes.
+  int estimate = spin_estimate_.load(std::memory_order_relaxed);
+  int limit = std::min(estimate * 2 + kMinSpins, kMaxSpins);
+  for (int spins = 0; spins < limit; ++spins) {
+    CpuRelax();
+    if (state_.load(std::memory_order_relaxed) != kUnlocked)
+      continue;
+    int expected = kUnlocked;
+    if (state_.compare_exchange_weak(expected, kLocked,
+                                     std::memory_order_acquire,
+                                     std::memory_order_relaxed)) {
+      spin_estimate_.store(estimate + (spins - estimate) / 8,
+                           std::memory_order_relaxed);
+      return;
+    }
+  }
+  spin_estimate_.store(estimate + (limit - estimate) / 8,
+                       std::memory_order_relaxed);
+
+  // Mark the lock as having waiters and sleep until it is released.
+  while (state_.exchange(kLockedWithWaiters, std::memory_order_acquire) !=
+         kUnlocked)
+    internal::FutexWait(&state_, kLockedWithWaiters);
+}
+
+void Lock::AcquireWithStats() {
+  int expected = kUnlocked;
+  if (state_.compare_exchange_strong(expected, kLocked,
+                                     std::memory_order_acquire,
+                                     std::memory_order_relaxed)) {
+    stats_->acquired_at = MonotonicNanoseconds();
+  } else {
+    long long wait_start = MonotonicNanoseconds();
+    AcquireContended();
+    stats_->acquired_at = MonotonicNanoseconds();
+    Increment(&stats_->contended_count, 1);
+    Increment(&stats_->total_wait_ns, stats_->acquired_at - wait_start);
+  }
+  Increment(&stats_->acquire_count, 1);
+}
+
+void Lock::ReleaseWithStats() {
+  long long held = MonotonicNanoseconds() - stats_->acquired_at;
+  if (held > stats_->max_hold_ns.load(std::memory_order_relaxed))
+    stats_->max_hold_ns.store(held, std::memory_order_relaxed);
+  stats_->acquired_at = 0;
+}
+
+// static
+void Lock::EnableContentionStats(bool enabled) {
+  g_stats_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+// static
+void Lock::DumpContentionStats(std::string* output) {
+  AutoLock locked(*RegistryLock());
+  std::vector<const internal::LockStats*> locks;
+  for (const internal::LockStats* stats = g_named_locks; stats;
+       stats = stats->next)
+    locks.push_back(stats);
+  std::stable_sort(locks.begin(), locks.end(), &HotterLock);
+
+  for (size_t i = 0; i < locks.size(); ++i) {
+    const internal::LockStats* stats = locks[i];
+    char line[256];
+    snprintf(line, sizeof(line),
+             "%s: acquires=%lld contended=%lld wait_us=%lld max_hold_us=%lld\n",
+             stats->name,
+             stats->acquire_count.load(std::memory_order_relaxed),
+             stats->contended_count.load(std::memory_order_relaxed),
+             stats->total_wait_ns.load(std::memory_order_relaxed) / 1000,
+             stats->max_hold_ns.load(std::memory_order_relaxed) / 1000);
+    output->append(line);
   }
-  return false;
 }
 
 }  // namespace base
@@ -5,16 +5,31 @@
 #ifndef BASE_LOCK_H_
 #define BASE_LOCK_H_
 
+#include <atomic>
+#include <string>
+
 namespace base {
 
-// A convenient wrapper for an OS specific critical section.  The only real
-// intelligence in this class is in debug mode for the support for the
-// AssertAcquired() method.
+namespace internal {
+struct LockStats;
+}
+
+// A mutex built on a futex word (WaitOnAddress on Windows).  An uncontended
+// Acquire() or Release() is a single atomic operation.  A contended Acquire()
+// spins before sleeping in the kernel; the spin budget adapts to how long
+// recent contended acquisitions had to spin, i.e. to the lock's recent hold
+// times, so short critical sections avoid the syscall and long ones stop
+// burning CPU.
+//
+// Locks constructed with a name record contention statistics while
+// EnableContentionStats(true) is in effect: acquisitions, contended
+// acquisitions, total time spent waiting and the longest hold time.
+// DumpContentionStats() reports every named lock, hottest first.
 class BASE_EXPORT Lock {
  public:
- typedef CRITICAL_SECTION NativeHandle;
-
   Lock();
+  // |name| must outlive the lock; use a string literal.
+  explicit Lock(const char* name);
   ~Lock();
   void Acquire();
   void Release();
@@ -25,10 +40,26 @@ class BASE_EXPORT Lock {
   // assertion may fail).
   bool Try();
 
+  // Starts or stops recording statistics for named locks.  Off by default;
+  // unnamed locks never record.
+  static void EnableContentionStats(bool enabled);
+
+  // Appends one line per named lock to |output|, sorted by total wait time.
+  static void DumpContentionStats(std::string* output);
+
  private:
+  void AcquireContended();
+  void AcquireWithStats();
+  void ReleaseWithStats();
+
+  // kUnlocked, kLocked, or kLockedWithWaiters once a thread may be sleeping.
+  std::atomic<int> state_;
+
+  // Running estimate of how many spins a contended Acquire() needs.
+  std::atomic<int> spin_estimate_;
 
-  // Platform specific underlying lock implementation.
-  NativeHandle native_handle_;
+  // Non-NULL for named locks.
+  internal::LockStats* stats_;
 
   DISALLOW_COPY_AND_ASSIGN(Lock);
 };
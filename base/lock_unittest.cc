@@ -0,0 +1,130 @@
+#include "base/lock.h"
+
+#include <stdio.h>
+#include <string>
+
+#include "base/platform_thread.h"
+#include "base/waitable_event.h"
+#include "gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kThreadCount = 4;
+const int kIncrementsPerThread = 100000;
+
+struct CounterParams {
+  Lock* lock;
+  // Deliberately not atomic: only the lock keeps the increments whole.
+  volatile int* counter;
+};
+
+void IncrementUnderLock(void* param) {
+  CounterParams* params = static_cast<CounterParams*>(param);
+  for (int i = 0; i < kIncrementsPerThread; ++i) {
+    AutoLock locked(*params->lock);
+    *params->counter = *params->counter + 1;
+  }
+}
+
+struct TryParams {
+  Lock* lock;
+  bool acquired;
+};
+
+void TryAndRelease(void* param) {
+  TryParams* params = static_cast<TryParams*>(param);
+  params->acquired = params->lock->Try();
+  if (params->acquired)
+    params->lock->Release();
+}
+
+bool TryOnOtherThread(Lock* lock) {
+  TryParams params = { lock, false };
+  PlatformThread::Handle thread;
+  EXPECT_TRUE(PlatformThread::Create(&TryAndRelease, &params, &thread));
+  PlatformThread::Join(thread);
+  return params.acquired;
+}
+
+struct ContenderParams {
+  Lock* lock;
+  WaitableEvent* about_to_acquire;
+};
+
+void AcquireAndRelease(void* param) {
+  ContenderParams* params = static_cast<ContenderParams*>(param);
+  params->about_to_acquire->Signal();
+  params->lock->Acquire();
+  params->lock->Release();
+}
+
+// Reads |name|'s counters from DumpContentionStats().
+bool GetContentionStats(const char* name, long long* acquires,
+  long long* contended) {
+  std::string stats;
+  Lock::DumpContentionStats(&stats);
+  std::string prefix = std::string(name) + ": ";
+  size_t line = stats.find(prefix);
+  if (line == std::string::npos)
+    return false;
+  return sscanf(stats.c_str() + line + prefix.size(),
+    "acquires=%lld contended=%lld", acquires, contended) == 2;
+}
+
+}  // namespace
+
+TEST(LockTest, MutualExclusionUnderContention) {
+  Lock lock;
+  volatile int counter = 0;
+  CounterParams params = { &lock, &counter };
+  PlatformThread::Handle threads[kThreadCount];
+  for (int i = 0; i < kThreadCount; ++i)
+    ASSERT_TRUE(PlatformThread::Create(&IncrementUnderLock, &params, &threads[i]));
+  for (int i = 0; i < kThreadCount; ++i)
+    PlatformThread::Join(threads[i]);
+  EXPECT_EQ(kThreadCount * kIncrementsPerThread, counter);
+}
+
+TEST(LockTest, TryFailsOnlyWhileHeld) {
+  Lock lock;
+  EXPECT_TRUE(TryOnOtherThread(&lock));
+  lock.Acquire();
+  EXPECT_FALSE(TryOnOtherThread(&lock));
+  lock.Release();
+  EXPECT_TRUE(TryOnOtherThread(&lock));
+
+  // Try() takes the lock like Acquire() does.
+  ASSERT_TRUE(lock.Try());
+  EXPECT_FALSE(TryOnOtherThread(&lock));
+  lock.Release();
+}
+
+TEST(LockTest, CountsContendedAcquisitions) {
+  Lock lock("LockTest.CountsContendedAcquisitions");
+  WaitableEvent about_to_acquire(true, false);
+  ContenderParams params = { &lock, &about_to_acquire };
+  Lock::EnableContentionStats(true);
+  lock.Acquire();
+  PlatformThread::Handle thread;
+  ASSERT_TRUE(PlatformThread::Create(&AcquireAndRelease, &params, &thread));
+  EXPECT_TRUE(about_to_acquire.TimedWait(5000));
+  // Long enough for the contender to give up spinning and sleep.
+  PlatformThread::Sleep(100);
+  lock.Release();
+  PlatformThread::Join(thread);
+  // Uncontended.
+  lock.Acquire();
+  lock.Release();
+  Lock::EnableContentionStats(false);
+
+  long long acquires = 0;
+  long long contended = 0;
+  ASSERT_TRUE(GetContentionStats("LockTest.CountsContendedAcquisitions",
+    &acquires, &contended));
+  EXPECT_EQ(3, acquires);
+  EXPECT_EQ(1, contended);
+}
+
+}  // namespace base
@@ -1,178 +1,517 @@
 #include "message_loop.h"
 
-#include <strsafe.h>
-#include "base/thread_local.h"
+#include <atomic>
+#include <vector>
+#include "base/epoch_reclaimer.h"
+#include "base/platform_thread.h"
 
 namespace {
-  static const wchar_t kWndClassFormat[] = L"WorkThreadWindow_%p";
+  // How often a Stop() with a timeout checks whether the loop has moved on to
+  // a CONTINUE_ON_SHUTDOWN task.
+  static const TimeDelta kStopPollIntervalMs = 10;
 
-  static const int kMsgHaveWork = WM_USER + 1;
+  // How often a busy loop, or one holding delayed tasks, sweeps cancelled
+  // tasks out of its queues.
+  static const TimeDelta kPurgeIntervalMs = 1000;
 
-  HMODULE GetModuleFromAddress(void* address) {
-    HMODULE instance = NULL;
-    if (!::GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
-      GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
-      static_cast<char*>(address),
-      &instance)) {
-    }
-    return instance;
-  }
-  base::Lock g_loops_lock;
-  MessageLoop* g_loops[MessageLoop::ID_COUNT];
-  HANDLE g_thread_handles[MessageLoop::ID_COUNT];
+  // The timer of the sweep.  Delayed tasks are numbered from 1.
+  static const int kPurgeTimerSequenceNum = -1;
 
-  struct ThreadParams {
-    MessageLoop::ID id;
+  // Thread names for hang reports, by MessageLoop::ID.
+  static const char* const kLoopNames[MessageLoop::ID_COUNT] = { "UI", "IO", "WORKER" };
+
+  // Lock names for contention stats, which need string literals.
+  static const char* const kTasksLockNames[MessageLoop::ID_COUNT] = {
+    "MessageLoop::tasks_lock_ (UI)",
+    "MessageLoop::tasks_lock_ (IO)",
+    "MessageLoop::tasks_lock_ (WORKER)"
+  };
+
+  // Secondary loops keep a message window on Windows, where they always had
+  // one.
+#if defined(OS_WIN)
+  static const MessageLoop::Type kSecondaryLoopType = MessageLoop::TYPE_UI;
+#else
+  static const MessageLoop::Type kSecondaryLoopType = MessageLoop::TYPE_DEFAULT;
+#endif
+
+  base::Lock g_loops_lock("g_loops_lock");
+  // Written under g_loops_lock.  Loops that outlive the poster may be read
+  // without it.
+  std::atomic<MessageLoop*> g_loops[MessageLoop::ID_COUNT];
+
+  enum StartState {
+    NOT_STARTED,
+    START_ON_DEMAND,
+    STARTED,
+    STOPPED
+  };
+
+  struct BufferedDelayedTask {
+    MessageLoop::PendingTask pending_task;
+    TimeDelta delayed_ms;
+    TimeTicks posted_at;
+  };
+
+  // Tasks posted to a loop that has not been created yet, handed over to it
+  // by its constructor.
+  struct TaskBuffer {
+    std::queue<MessageLoop::PendingTask> tasks;
+    std::vector<BufferedDelayedTask> delayed_tasks;
+  };
+
+  // An object handed to DeleteSoon() or ReleaseSoon().
+  struct PendingDestruction {
+    void (*destroy)(const void*);
+    const void* object;
   };
 
-  struct TimerParams {
-    MessageLoop* message_loop;
-    TimeTicks timer_id;
+  // Per-loop bookkeeping that outlives the MessageLoop object itself.  The
+  // plain fields are guarded by g_loops_lock.
+  struct LoopState {
+    bool has_thread;
+    base::PlatformThread::Handle thread_handle;
+    // Stop() gave up on the thread, which still owns |thread_handle| until
+    // it is joined by the next Start() or Stop().
+    bool thread_abandoned;
+    StartState start_state;
+    TaskBuffer* buffer;
+    // Set once shutdown starts; the loop then drops tasks that do not block
+    // shutdown.
+    std::atomic<bool> shutdown_requested;
+    std::atomic<bool> running_continue_on_shutdown_task;
+    // Tasks dropped as they were posted, because the loop was shutting down
+    // or stopped.  Reported, and reset, by the next Stop().
+    std::atomic<size_t> tasks_dropped;
+    // Written by the loop's thread while draining, read by Stop() once the
+    // thread has exited.
+    MessageLoop::ShutdownStats stats;
+    // Objects waiting to be destroyed on the loop.  A task to free them is
+    // pending whenever this is not empty.
+    base::Lock destructions_lock;
+    std::vector<PendingDestruction> destructions;
   };
+  LoopState g_loop_states[MessageLoop::ID_COUNT];
 
-  DWORD CALLBACK ThreadMain(void* params) {
+  std::atomic<bool> g_fast_shutdown(false);
+
+  struct ThreadParams {
+    MessageLoop::ID id;
+  };
+
+  void ThreadMain(void* params) {
     ThreadParams* thread_params = static_cast<ThreadParams*>(params);
     MessageLoop::ID type = thread_params->id;
     delete thread_params;
-    scoped_ptr<MessageLoop> message_loop(new MessageLoop(type));
+    scoped_ptr<MessageLoop> message_loop(new MessageLoop(type, kSecondaryLoopType));
     message_loop->Run();
-    return 0;
-  }
-
-  LRESULT CALLBACK WndProcThunk(HWND window_handle, UINT message, WPARAM wparam,
-    LPARAM lparam) {
-    switch (message) {
-    case kMsgHaveWork:
-      reinterpret_cast<MessageLoop*>(wparam)->HandleHaveWorkMessage();
-      break;
-    case WM_TIMER:
-      {
-        KillTimer(window_handle, wparam);
-        TimerParams* params = reinterpret_cast<TimerParams*>(wparam);
-        params->message_loop->HandleTimerMessage(params->timer_id);
-        delete params;
-        break;
-      }
+  }
+
+#if defined(OS_WIN)
+  base::MessagePump* CreatePump(MessageLoop::Type type,
+    base::MessagePump::Delegate* delegate) {
+    if (type == MessageLoop::TYPE_UI)
+      return new base::MessagePumpForUI(delegate);
+    return new base::MessagePumpDefault(delegate);
+  }
+#else
+  // Every loop is TYPE_DEFAULT here.
+  base::MessagePump* CreatePump(MessageLoop::Type /* type */,
+    base::MessagePump::Delegate* delegate) {
+    return new base::MessagePumpDefault(delegate);
+  }
+#endif
+
+  void RunPendingDestructions(MessageLoop::ID identifier) {
+    LoopState& state = g_loop_states[identifier];
+    std::vector<PendingDestruction> destructions;
+    {
+      base::AutoLock locked(state.destructions_lock);
+      destructions.swap(state.destructions);
     }
-    return ::DefWindowProc(window_handle, message, wparam, lparam);
+    // Objects handed over from here on are freed by the next task.
+    for (size_t i = 0; i < destructions.size(); ++i)
+      destructions[i].destroy(destructions[i].object);
   }
 
   void QuitCurrentHelper() {
-    MessageLoop::current()->Quit();
+    MessageLoop* message_loop = MessageLoop::current();
+    message_loop->DrainForShutdown(&g_loop_states[message_loop->id()].stats);
+    message_loop->Quit();
   }
 
-  base::ThreadLocalPointer<MessageLoop> g_tls;
+  // Requires g_loops_lock.
+  void StartThreadLocked(MessageLoop::ID identifier) {
+    LoopState& state = g_loop_states[identifier];
+    if (state.has_thread) {
+      // One thread per loop: an abandoned thread must exit first.
+      if (!state.thread_abandoned ||
+        !base::PlatformThread::TimedJoin(state.thread_handle, 0))
+        return;
+      state.has_thread = false;
+      state.thread_abandoned = false;
+    }
+    ThreadParams* params = new ThreadParams();
+    params->id = identifier;
+    state.shutdown_requested.store(false, std::memory_order_relaxed);
+    if (!base::PlatformThread::Create(&ThreadMain, params, &state.thread_handle)) {
+      delete params;
+      return;
+    }
+    state.has_thread = true;
+    state.start_state = STARTED;
+  }
+
+  // Requires g_loops_lock.
+  void BufferTaskLocked(MessageLoop::ID identifier,
+    MessageLoop::PendingTask pending_task, TimeDelta delayed_ms) {
+    TaskBuffer*& buffer = g_loop_states[identifier].buffer;
+    if (!buffer)
+      buffer = new TaskBuffer();
+    if (delayed_ms == 0) {
+      buffer->tasks.push(std::move(pending_task));
+    } else {
+      BufferedDelayedTask delayed_task = { std::move(pending_task), delayed_ms, base::TickCount() };
+      buffer->delayed_tasks.push_back(std::move(delayed_task));
+    }
+  }
+
+  // Waits for a stopping loop's thread for at most |timeout_ms|.  With a
+  // finite timeout, gives up early if the loop is busy with a task shutdown
+  // does not wait for.  The thread is joined if it exited.
+  bool WaitForLoopThread(base::PlatformThread::Handle thread_handle,
+    TimeDelta timeout_ms, const LoopState& state) {
+    if (timeout_ms == kInfiniteTimeDelta)
+      return base::PlatformThread::TimedJoin(thread_handle, kInfiniteTimeDelta);
+    TimeTicks wait_start = base::TickCount();
+    for (;;) {
+      TimeDelta elapsed = base::TickCount() - wait_start;
+      if (elapsed >= timeout_ms)
+        return false;
+      TimeDelta wait_ms = kStopPollIntervalMs;
+      if (timeout_ms - elapsed < wait_ms)
+        wait_ms = timeout_ms - elapsed;
+      if (base::PlatformThread::TimedJoin(thread_handle, wait_ms))
+        return true;
+      if (state.running_continue_on_shutdown_task.load(std::memory_order_relaxed))
+        return false;
+    }
+  }
+
+  // Moves the cancelled tasks in |queue| to |purged|, keeping the order of
+  // the rest.
+  void RemoveCancelledTasks(std::queue<MessageLoop::PendingTask>* queue,
+    std::vector<MessageLoop::PendingTask>* purged) {
+    for (size_t count = queue->size(); count > 0; --count) {
+      MessageLoop::PendingTask pending_task = std::move(queue->front());
+      queue->pop();
+      if (pending_task.task.IsCancelled())
+        purged->push_back(std::move(pending_task));
+      else
+        queue->push(std::move(pending_task));
+    }
+  }
+}
+
+MessageLoop::PendingTask::PendingTask(const base::Location& posted_from,
+  base::OnceClosure task, TaskShutdownBehavior shutdown_behavior)
+  : posted_from(posted_from)
+  , task(std::move(task))
+  , shutdown_behavior(shutdown_behavior) {
 }
 
-MessageLoop* MessageLoop::current() {
-  return g_tls.Get();
+MessageLoop::PendingTask::PendingTask(PendingTask&& other)
+  : posted_from(other.posted_from)
+  , task(std::move(other.task))
+  , shutdown_behavior(other.shutdown_behavior) {
 }
 
+MessageLoop::PendingTask& MessageLoop::PendingTask::operator=(PendingTask&& other) {
+  posted_from = other.posted_from;
+  task = std::move(other.task);
+  shutdown_behavior = other.shutdown_behavior;
+  return *this;
+}
+
+MessageLoop::ShutdownStats::ShutdownStats()
+  : shutdown_ns(0)
+  , drain_ns(0)
+  , tasks_run(0)
+  , tasks_skipped(0)
+  , tasks_purged(0)
+  , total_tasks_posted(0)
+  , total_tasks_run(0)
+  , abandoned(false) {
+}
+
+BASE_THREAD_LOCAL_POD MessageLoop* MessageLoop::current_;
+
 void MessageLoop::Start(ID identifier) {
   if (identifier > UI && identifier < ID_COUNT) {
-    ThreadParams* params = new ThreadParams();
-    params->id = identifier;
-    g_thread_handles[identifier] = CreateThread(NULL, 0, ThreadMain, (void*)params, 0, NULL);
-    if (!g_thread_handles[identifier]) {
-      delete params;
-    }
+    base::AutoLock locked(g_loops_lock);
+    StartThreadLocked(identifier);
   }
 }
 
-void MessageLoop::Stop(ID identifier) {
+void MessageLoop::StartLazily(ID identifier) {
   if (identifier > UI && identifier < ID_COUNT) {
-    PostTask(identifier, base::Bind(&QuitCurrentHelper));
-    DWORD result = WaitForSingleObject(g_thread_handles[identifier], INFINITE);
-    CloseHandle(g_thread_handles[identifier]);
-    g_thread_handles[identifier] = 0;
+    base::AutoLock locked(g_loops_lock);
+    StartState& start_state = g_loop_states[identifier].start_state;
+    if (start_state == NOT_STARTED || start_state == STOPPED)
+      start_state = START_ON_DEMAND;
   }
 }
 
-void MessageLoop::PostTask(ID identifier, const base::Closure& task) {
-  PostDelayedTask(identifier, task, 0);
+void MessageLoop::Stop(ID identifier) {
+  Stop(identifier, kInfiniteTimeDelta, NULL);
+}
+
+bool MessageLoop::Stop(ID identifier, TimeDelta timeout_ms, ShutdownStats* stats) {
+  if (identifier <= UI || identifier >= ID_COUNT)
+    return true;
+
+  long long shutdown_start = base::MonotonicNanoseconds();
+  LoopState& state = g_loop_states[identifier];
+  bool has_thread = false;
+  bool loop_stopped = false;
+  base::PlatformThread::Handle thread_handle = base::PlatformThread::Handle();
+  scoped_ptr<TaskBuffer> unclaimed_tasks;
+  {
+    base::AutoLock locked(g_loops_lock);
+    state.shutdown_requested.store(true, std::memory_order_relaxed);
+    has_thread = state.has_thread;
+    thread_handle = state.thread_handle;
+    // Joined below; keeps a concurrent Start() from joining it too.
+    state.thread_abandoned = false;
+    loop_stopped = state.start_state == STOPPED;
+    if (!has_thread) {
+      // Never started: drop whatever was posted to it, outside the lock.
+      state.start_state = STOPPED;
+      unclaimed_tasks.reset(state.buffer);
+      state.buffer = NULL;
+    }
+  }
+
+  ShutdownStats result;
+  bool exited = true;
+  if (!has_thread) {
+    if (unclaimed_tasks.get()) {
+      result.tasks_skipped = unclaimed_tasks->tasks.size() +
+        unclaimed_tasks->delayed_tasks.size();
+      if (g_fast_shutdown.load(std::memory_order_relaxed))
+        unclaimed_tasks.release();
+    }
+  } else {
+    // Tasks queued ahead of this one are dropped or run as it reaches them.
+    // A thread abandoned earlier may have no loop left to quit.
+    if (!loop_stopped)
+      PostTask(FROM_HERE, identifier, BLOCK_SHUTDOWN, base::Bind(&QuitCurrentHelper));
+    exited = WaitForLoopThread(thread_handle, timeout_ms, state);
+    if (exited)
+      result = state.stats;
+    result.abandoned = !exited;
+    // An abandoned thread keeps the loop's slot until it is joined, so that
+    // Start() cannot run a second thread for the same loop.
+    base::AutoLock locked(g_loops_lock);
+    if (exited)
+      state.has_thread = false;
+    else
+      state.thread_abandoned = true;
+  }
+  result.tasks_skipped += state.tasks_dropped.exchange(0, std::memory_order_relaxed);
+  result.shutdown_ns = base::MonotonicNanoseconds() - shutdown_start;
+  if (stats)
+    *stats = result;
+  return exited;
+}
+
+void MessageLoop::SetFastShutdown(bool fast_shutdown) {
+  g_fast_shutdown.store(fast_shutdown, std::memory_order_relaxed);
+}
+
+void MessageLoop::PostTask(ID identifier, base::OnceClosure task) {
+  PostDelayedTask(base::Location(), identifier, SKIP_ON_SHUTDOWN, std::move(task), 0);
+}
+
+void MessageLoop::PostTask(ID identifier, base::Closure&& task) {
+  PostDelayedTask(base::Location(), identifier, SKIP_ON_SHUTDOWN,
+    base::OnceClosure(std::move(task)), 0);
+}
+
+void MessageLoop::PostTask(ID identifier, TaskShutdownBehavior shutdown_behavior,
+  base::OnceClosure task) {
+  PostDelayedTask(base::Location(), identifier, shutdown_behavior, std::move(task), 0);
+}
+
+void MessageLoop::PostDelayedTask(ID identifier, base::OnceClosure task, TimeDelta delayed_ms) {
+  PostDelayedTask(base::Location(), identifier, SKIP_ON_SHUTDOWN, std::move(task), delayed_ms);
+}
+
+void MessageLoop::PostDelayedTask(ID identifier, TaskShutdownBehavior shutdown_behavior,
+  base::OnceClosure task, TimeDelta delayed_ms) {
+  PostDelayedTask(base::Location(), identifier, shutdown_behavior, std::move(task), delayed_ms);
+}
+
+void MessageLoop::PostTask(const base::Location& from_here, ID identifier,
+  base::OnceClosure task) {
+  PostDelayedTask(from_here, identifier, SKIP_ON_SHUTDOWN, std::move(task), 0);
 }
 
-void MessageLoop::PostDelayedTask(ID identifier, const base::Closure& task, TimeDelta delayed_ms) {
-  bool target_thread_outlives_current =
-    MessageLoop::current()->id() >= identifier;
-  if (!target_thread_outlives_current)
-    g_loops_lock.Acquire();
-  MessageLoop* message_loop = g_loops[identifier];
+void MessageLoop::PostTask(const base::Location& from_here, ID identifier,
+  TaskShutdownBehavior shutdown_behavior, base::OnceClosure task) {
+  PostDelayedTask(from_here, identifier, shutdown_behavior, std::move(task), 0);
+}
+
+void MessageLoop::PostDelayedTask(const base::Location& from_here, ID identifier,
+  base::OnceClosure task, TimeDelta delayed_ms) {
+  PostDelayedTask(from_here, identifier, SKIP_ON_SHUTDOWN, std::move(task), delayed_ms);
+}
+
+void MessageLoop::PostDelayedTask(const base::Location& from_here, ID identifier,
+  TaskShutdownBehavior shutdown_behavior, base::OnceClosure task,
+  TimeDelta delayed_ms) {
+  PendingTask pending_task(from_here, std::move(task), shutdown_behavior);
+
+  // Once running, a loop that outlives the current one cannot go away under
+  // us, so it is used without taking g_loops_lock.
+  MessageLoop* current_loop = current();
+  if (current_loop && current_loop->id() >= identifier) {
+    MessageLoop* message_loop = g_loops[identifier].load(std::memory_order_acquire);
+    if (message_loop) {
+      message_loop->PostandSchduleTask(std::move(pending_task), delayed_ms);
+      return;
+    }
+  }
+
+  base::AutoLock locked(g_loops_lock);
+  MessageLoop* message_loop = g_loops[identifier].load(std::memory_order_relaxed);
   if (message_loop) {
-    message_loop->PostandSchduleTask(task, delayed_ms);
+    message_loop->PostandSchduleTask(std::move(pending_task), delayed_ms);
+    return;
   }
-  if (!target_thread_outlives_current)
-    g_loops_lock.Release();
+  LoopState& state = g_loop_states[identifier];
+  if (state.start_state == STOPPED) {
+    state.tasks_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if (state.start_state == START_ON_DEMAND)
+    StartThreadLocked(identifier);
+  BufferTaskLocked(identifier, std::move(pending_task), delayed_ms);
 }
 
 bool MessageLoop::CurrentlyOn(ID identifer) {
-  return current()->id() == identifer;
+  MessageLoop* message_loop = current();
+  return message_loop && message_loop->id() == identifer;
 }
 
-MessageLoop::MessageLoop(ID identifier)
-  : atom_(0), id_(identifier) {
-  InitMessageWnd();
-  g_tls.Set(this);
-  base::AutoLock locked(g_loops_lock);
-  g_loops[identifier] = this;
+void MessageLoop::DestroySoon(ID identifier, void (*destroy)(const void*),
+  const void* object) {
+  LoopState& state = g_loop_states[identifier];
+  bool first_in_batch = false;
+  {
+    base::AutoLock locked(state.destructions_lock);
+    first_in_batch = state.destructions.empty();
+    PendingDestruction destruction = { destroy, object };
+    state.destructions.push_back(destruction);
+  }
+  if (first_in_batch)
+    PostTask(FROM_HERE, identifier, base::Bind(&RunPendingDestructions, identifier));
 }
 
-MessageLoop::~MessageLoop() {
-  DestroyWindow(message_hwnd_);
-  UnregisterClass(MAKEINTATOM(atom_),
-    GetModuleFromAddress(&WndProcThunk));
-  g_tls.Set(NULL);
+MessageLoop::MessageLoop(ID identifier, Type type)
+  : pump_(CreatePump(type, this))
+  , tasks_lock_(kTasksLockNames[identifier])
+  , next_sequence_num_(1)
+  , accepting_tasks_(true)
+  , tasks_skipped_(0)
+  , leaked_tasks_(NULL)
+  , tasks_purged_(0)
+  , last_purge_(base::TickCount())
+  , purge_timer_armed_(false)
+  , task_depth_(0)
+  , hang_watch_(kLoopNames[identifier])
+  , id_(identifier) {
+  current_ = this;
+  base::EpochReclaimer::RegisterThread();
+
+  // Declared before |locked| so that tasks dropped while adopting the buffer
+  // are destroyed after the lock is released.
+  scoped_ptr<TaskBuffer> buffer;
   base::AutoLock locked(g_loops_lock);
-  g_loops[id_] = NULL;
+  LoopState& state = g_loop_states[identifier];
+  state.start_state = STARTED;
+  buffer.reset(state.buffer);
+  state.buffer = NULL;
+  if (buffer.get()) {
+    // Nothing else can touch the queues until the loop is published below.
+    // Take the whole immediate queue over without copying a single task.
+    tasks_.swap(buffer->tasks);
+    for (size_t i = 0; i < tasks_.size(); ++i)
+      pump_->ScheduleWork();
+
+    // Delayed tasks keep the deadline they were posted with.
+    TimeTicks now = base::TickCount();
+    for (size_t i = 0; i < buffer->delayed_tasks.size(); ++i) {
+      BufferedDelayedTask& delayed_task = buffer->delayed_tasks[i];
+      TimeDelta elapsed = now - delayed_task.posted_at;
+      TimeDelta remaining_ms = elapsed < delayed_task.delayed_ms ? delayed_task.delayed_ms - elapsed : 0;
+      PostandSchduleTask(std::move(delayed_task.pending_task), remaining_ms);
+    }
+  }
+  g_loops[identifier].store(this, std::memory_order_release);
 }
 
-void MessageLoop::InitMessageWnd() {
-  wchar_t class_name[MAX_PATH] = {0};
-  StringCchPrintf(class_name, MAX_PATH-1, kWndClassFormat, this);
-  HINSTANCE instance = GetModuleFromAddress(&WndProcThunk);
-  WNDCLASSEX wc = {0};
-  wc.cbSize = sizeof(wc);
-  wc.lpfnWndProc = &WndProcThunk;
-  wc.hInstance = instance;
-  wc.lpszClassName = class_name;
-  atom_ = RegisterClassEx(&wc);
-
-  message_hwnd_ = CreateWindow(MAKEINTATOM(atom_), 0, 0, 0, 0, 0, 0,
-    HWND_MESSAGE, 0, instance, 0);
+MessageLoop::~MessageLoop() {
+  pump_.reset();
+  current_ = NULL;
+  base::EpochReclaimer::UnregisterThread();
+  base::AutoLock locked(g_loops_lock);
+  g_loops[id_].store(NULL, std::memory_order_relaxed);
+  LoopState& state = g_loop_states[id_];
+  state.start_state = STOPPED;
+  // The UI loop is created again without Start(), which resets this for the
+  // others.
+  state.shutdown_requested.store(false, std::memory_order_relaxed);
 }
 
 void MessageLoop::Run() {
-  BOOL bRet = FALSE;
-  MSG msg;
-  while((bRet = ::GetMessage(&msg, NULL, 0, 0)) != 0) {
-    if (bRet == -1) {
-      continue;
-    } else {
-      TranslateMessage(&msg);
-      DispatchMessage(&msg);
-    }
-  }
+  pump_->Run();
 }
 
 void MessageLoop::Quit() {
-  PostQuitMessage(0);
+  pump_->Quit();
 }
 
-void MessageLoop::PostandSchduleTask(const base::Closure& task, TimeDelta delayed_ms) {
+void MessageLoop::PostandSchduleTask(PendingTask pending_task, TimeDelta delayed_ms) {
   base::AutoLock locked(tasks_lock_);
+  LoopState& state = g_loop_states[id_];
+  if (!accepting_tasks_ ||
+    (state.shutdown_requested.load(std::memory_order_relaxed) &&
+    (delayed_ms != 0 || pending_task.shutdown_behavior != BLOCK_SHUTDOWN))) {
+    state.tasks_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  tasks_posted_.Increment();
   if (delayed_ms == 0) {
-    tasks_.push(task);
-    ::PostMessage(message_hwnd_, kMsgHaveWork, reinterpret_cast<WPARAM>(this), 0);
+    tasks_.push(std::move(pending_task));
+    queue_depth_.Record(tasks_.size());
+    pump_->ScheduleWork();
   } else {
-    TimerParams* params = new TimerParams();
-    params->message_loop = this;
-    params->timer_id = ::GetTickCount();
-    delayed_tasks_.insert(std::make_pair(params->timer_id, task));
-    ::SetTimer(message_hwnd_, reinterpret_cast<UINT_PTR>(params), delayed_ms, NULL);
+    int sequence_num = next_sequence_num_++;
+    delayed_tasks_.insert(std::make_pair(sequence_num, std::move(pending_task)));
+    pump_->ScheduleDelayedWork(sequence_num, delayed_ms);
+    // An idle loop would otherwise keep cancelled delayed tasks, and what
+    // they hold, until their timers fire.
+    if (!purge_timer_armed_) {
+      purge_timer_armed_ = true;
+      pump_->ScheduleDelayedWork(kPurgeTimerSequenceNum, kPurgeIntervalMs);
+    }
   }
 }
 
 void MessageLoop::HandleHaveWorkMessage() {
+  MaybePurgeCancelledTasks();
   if (work_queue_.empty()) {
     base::AutoLock locked(tasks_lock_);
     if (!tasks_.empty())
@@ -180,18 +519,157 @@ void MessageLoop::HandleHaveWorkMessage() {
   }
 
   if (!work_queue_.empty()) {
-    base::Closure task = work_queue_.front();
+    PendingTask pending_task = std::move(work_queue_.front());
     work_queue_.pop();
-    task.Run();
+    if (g_loop_states[id_].shutdown_requested.load(std::memory_order_relaxed) &&
+      pending_task.shutdown_behavior != BLOCK_SHUTDOWN)
+      DiscardTask(&pending_task);
+    else
+      RunTask(&pending_task);
   }
 }
 
-void MessageLoop::HandleTimerMessage(TimeTicks timer_id) {
-  base::AutoLock locked(tasks_lock_);
-  std::map<TimeTicks, base::Closure>::iterator iter = delayed_tasks_.find(timer_id);
-  if (iter != delayed_tasks_.end()) {
-    base::Closure task = iter->second;
+void MessageLoop::HandleTimerMessage(int sequence_num) {
+  if (sequence_num == kPurgeTimerSequenceNum) {
+    PurgeCancelledTasks();
+    base::AutoLock locked(tasks_lock_);
+    purge_timer_armed_ = !delayed_tasks_.empty() && accepting_tasks_;
+    if (purge_timer_armed_)
+      pump_->ScheduleDelayedWork(kPurgeTimerSequenceNum, kPurgeIntervalMs);
+    return;
+  }
+  MaybePurgeCancelledTasks();
+  PendingTask pending_task(base::Location(), base::OnceClosure(), SKIP_ON_SHUTDOWN);
+  {
+    base::AutoLock locked(tasks_lock_);
+    std::map<int, PendingTask>::iterator iter = delayed_tasks_.find(sequence_num);
+    if (iter == delayed_tasks_.end())
+      return;
+    pending_task = std::move(iter->second);
     delayed_tasks_.erase(iter);
-    task.Run();
+  }
+  // base::Lock is not recursive: the task may post back to this loop.
+  if (g_loop_states[id_].shutdown_requested.load(std::memory_order_relaxed))
+    DiscardTask(&pending_task);
+  else
+    RunTask(&pending_task);
+}
+
+void MessageLoop::DrainForShutdown(ShutdownStats* stats) {
+  long long drain_start = base::MonotonicNanoseconds();
+  g_loop_states[id_].shutdown_requested.store(true, std::memory_order_relaxed);
+
+  size_t tasks_run = 0;
+  for (;;) {
+    {
+      base::AutoLock locked(tasks_lock_);
+      if (work_queue_.empty()) {
+        tasks_.swap(work_queue_);
+      } else {
+        for (; !tasks_.empty(); tasks_.pop())
+          work_queue_.push(std::move(tasks_.front()));
+      }
+      if (work_queue_.empty()) {
+        accepting_tasks_ = false;
+        break;
+      }
+    }
+    // Popped before running: a task may spin a nested loop that takes more
+    // work off the queue.
+    while (!work_queue_.empty()) {
+      PendingTask pending_task = std::move(work_queue_.front());
+      work_queue_.pop();
+      if (pending_task.shutdown_behavior == BLOCK_SHUTDOWN) {
+        RunTask(&pending_task);
+        ++tasks_run;
+      } else {
+        DiscardTask(&pending_task);
+      }
+    }
+  }
+
+  std::map<int, PendingTask> delayed_tasks;
+  {
+    base::AutoLock locked(tasks_lock_);
+    delayed_tasks.swap(delayed_tasks_);
+    if (purge_timer_armed_) {
+      pump_->CancelDelayedWork(kPurgeTimerSequenceNum);
+      purge_timer_armed_ = false;
+    }
+  }
+  for (std::map<int, PendingTask>::iterator iter = delayed_tasks.begin();
+    iter != delayed_tasks.end(); ++iter) {
+    pump_->CancelDelayedWork(iter->first);
+    DiscardTask(&iter->second);
+  }
+
+  stats->drain_ns = base::MonotonicNanoseconds() - drain_start;
+  stats->tasks_run = tasks_run;
+  stats->tasks_skipped = tasks_skipped_;
+  stats->tasks_purged = tasks_purged_;
+  stats->total_tasks_posted = tasks_posted_.value();
+  stats->total_tasks_run = tasks_run_.value();
+  stats->queue_depth = queue_depth_.GetSnapshot();
+}
+
+size_t MessageLoop::PurgeCancelledTasks() {
+  last_purge_ = base::TickCount();
+  // Destroyed after the lock is released: a task's destructor may post.
+  std::vector<PendingTask> purged;
+  RemoveCancelledTasks(&work_queue_, &purged);
+  {
+    base::AutoLock locked(tasks_lock_);
+    RemoveCancelledTasks(&tasks_, &purged);
+    std::map<int, PendingTask>::iterator iter = delayed_tasks_.begin();
+    while (iter != delayed_tasks_.end()) {
+      if (iter->second.task.IsCancelled()) {
+        pump_->CancelDelayedWork(iter->first);
+        purged.push_back(std::move(iter->second));
+        delayed_tasks_.erase(iter++);
+      } else {
+        ++iter;
+      }
+    }
+  }
+  // The kMsgHaveWork messages of purged tasks find nothing left to run.
+  tasks_purged_ += purged.size();
+  return purged.size();
+}
+
+void MessageLoop::MaybePurgeCancelledTasks() {
+  if (base::TickCount() - last_purge_ >= kPurgeIntervalMs)
+    PurgeCancelledTasks();
+}
+
+void MessageLoop::RunTask(PendingTask* pending_task) {
+  ++task_depth_;
+  tasks_run_.Increment();
+  hang_watch_.TaskStarted(pending_task->posted_from);
+  if (pending_task->shutdown_behavior == CONTINUE_ON_SHUTDOWN) {
+    std::atomic<bool>& running = g_loop_states[id_].running_continue_on_shutdown_task;
+    running.store(true, std::memory_order_relaxed);
+    pending_task->task.Run();
+    running.store(false, std::memory_order_relaxed);
+  } else {
+    pending_task->task.Run();
+  }
+  // Tasks run by a nested loop take the outer task's place in the watch,
+  // which counts it as finished once they return.
+  hang_watch_.TaskFinished();
+  // A task in a nested loop returns while the outer one still uses the arena.
+  if (--task_depth_ == 0)
+    task_arena_.Reset();
+  // Tasks keep no pointers into structures protected by EpochReclaimer.
+  base::EpochReclaimer::QuiescentState();
+}
+
+void MessageLoop::DiscardTask(PendingTask* pending_task) {
+  ++tasks_skipped_;
+  if (g_fast_shutdown.load(std::memory_order_relaxed)) {
+    // Parking the task where it is never destroyed skips its bound state's
+    // destructors.
+    if (!leaked_tasks_)
+      leaked_tasks_ = new std::vector<PendingTask>();
+    leaked_tasks_->push_back(std::move(*pending_task));
   }
 }
\ No newline at end of file
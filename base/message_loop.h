@@ -3,42 +3,240 @@
 
 #include <queue>
 #include <map>
+#include <vector>
+#include "base/arena.h"
 #include "base/closure.h"
+#include "base/counter.h"
+#include "base/hang_watchdog.h"
+#include "base/histogram.h"
+#include "base/location.h"
+#include "base/message_pump.h"
+#include "base/once_closure.h"
 #include "base/lock.h"
+#include "base/scoped_ptr.h"
+#include "base/time.h"
 
-typedef unsigned long TimeDelta;
-typedef unsigned long TimeTicks;
-
-class BASE_EXPORT MessageLoop {
+class BASE_EXPORT MessageLoop : public base::MessagePump::Delegate {
 public:
   enum ID {
     UI = 0,
     IO,
+    // Blocking work, such as reading files, that must not hold up IO.
+    WORKER,
     ID_COUNT
   };
-  static MessageLoop* current();
+
+  // How the loop waits for work.
+  enum Type {
+    // Tasks only; no native messages are pumped.
+    TYPE_DEFAULT,
+    // Pumps native window messages as well, so that the thread can own
+    // windows.  Windows only; elsewhere the same as TYPE_DEFAULT.
+    TYPE_UI
+  };
+
+  // What happens to a task that has not run yet when its loop shuts down.
+  enum TaskShutdownBehavior {
+    // Dropped if it has not started.  Stop() does not wait for it while it
+    // runs, so it must not touch anything torn down at shutdown.
+    CONTINUE_ON_SHUTDOWN,
+    // Dropped if it has not started.  The default.
+    SKIP_ON_SHUTDOWN,
+    // Always run before the loop exits.  Delayed tasks cannot block shutdown
+    // and are treated as SKIP_ON_SHUTDOWN.
+    BLOCK_SHUTDOWN
+  };
+
+  // Move-only, like the OnceClosure it carries.
+  struct PendingTask {
+    PendingTask(const base::Location& posted_from, base::OnceClosure task,
+      TaskShutdownBehavior shutdown_behavior);
+    PendingTask(PendingTask&& other);
+    PendingTask& operator=(PendingTask&& other);
+    base::Location posted_from;
+    base::OnceClosure task;
+    TaskShutdownBehavior shutdown_behavior;
+  };
+
+  struct ShutdownStats {
+    ShutdownStats();
+    // From the shutdown request until the thread exited or Stop() gave up.
+    long long shutdown_ns;
+    // Time spent running BLOCK_SHUTDOWN tasks and dropping the rest.
+    long long drain_ns;
+    size_t tasks_run;
+    // Includes tasks dropped as they were posted, during shutdown or while
+    // the loop was stopped.
+    size_t tasks_skipped;
+    // Cancelled tasks swept out of the queues over the loop's lifetime.
+    size_t tasks_purged;
+    // Over the loop's lifetime, including delayed tasks.
+    long long total_tasks_posted;
+    long long total_tasks_run;
+    // See MessageLoop::queue_depth().
+    base::Histogram::Snapshot queue_depth;
+    // Stop() returned with the thread still running, because the timeout
+    // expired or the loop was busy with a CONTINUE_ON_SHUTDOWN task.  The
+    // drain figures are not available then.  The loop cannot be started
+    // again until that thread exits.
+    bool abandoned;
+  };
+
+  // The loop of the calling thread, or NULL.  A single inline load.
+  static MessageLoop* current() { return current_; }
+  // Starts the thread for |identifier| now, also after Stop().  Does nothing
+  // if it is running.
   static void Start(ID identifier);
+  // Defers starting the thread for |identifier| until a task is posted to it.
+  // Tasks posted to any loop before it runs are buffered and handed over
+  // when it comes up.  A stopped loop drops tasks posted to it until it is
+  // started again by either call.
+  static void StartLazily(ID identifier);
+  // Shuts the loop down and waits for its thread to exit, however long a
+  // CONTINUE_ON_SHUTDOWN task keeps it busy.
   static void Stop(ID identifier);
-  static void PostTask(ID identifier, const base::Closure& task);
-  static void PostDelayedTask(ID identifier, const base::Closure& task, TimeDelta delayed_ms);
+  // Same, but waits at most |timeout_ms|.  Returns false if the thread was
+  // left running.  |stats| may be NULL.
+  static bool Stop(ID identifier, TimeDelta timeout_ms, ShutdownStats* stats);
+  // While set, tasks dropped at shutdown are leaked instead of destroyed, so
+  // their bound arguments are never released.  For processes that exit right
+  // after shutting down.
+  static void SetFastShutdown(bool fast_shutdown);
+  // Tasks are taken as OnceClosures; a Closure converts implicitly.
+  static void PostTask(ID identifier, base::OnceClosure task);
+  // A Closure that is not needed afterwards, such as the result of Bind(),
+  // is moved into the queue without a reference count round trip.
+  static void PostTask(ID identifier, base::Closure&& task);
+  static void PostTask(ID identifier, TaskShutdownBehavior shutdown_behavior,
+    base::OnceClosure task);
+  static void PostDelayedTask(ID identifier, base::OnceClosure task, TimeDelta delayed_ms);
+  static void PostDelayedTask(ID identifier, TaskShutdownBehavior shutdown_behavior,
+    base::OnceClosure task, TimeDelta delayed_ms);
+  // The same, recording where the task was posted from for hang reports:
+  //
+  //   MessageLoop::PostTask(FROM_HERE, MessageLoop::IO, base::Bind(&Load));
+  static void PostTask(const base::Location& from_here, ID identifier,
+    base::OnceClosure task);
+  static void PostTask(const base::Location& from_here, ID identifier,
+    TaskShutdownBehavior shutdown_behavior, base::OnceClosure task);
+  static void PostDelayedTask(const base::Location& from_here, ID identifier,
+    base::OnceClosure task, TimeDelta delayed_ms);
+  static void PostDelayedTask(const base::Location& from_here, ID identifier,
+    TaskShutdownBehavior shutdown_behavior, base::OnceClosure task,
+    TimeDelta delayed_ms);
   static bool CurrentlyOn(ID identifier);
 
-  explicit MessageLoop(ID identifier);
+  // Destroys |object| on loop |identifier| instead of the calling thread,
+  // keeping expensive destructors off latency-sensitive loops.  Objects
+  // handed over before the loop gets to them are freed together by a single
+  // task.  Like other tasks, they are leaked if the loop shuts down first.
+  template <typename T>
+  static void DeleteSoon(ID identifier, const T* object) {
+    DestroySoon(identifier, &DeleteObject<T>, object);
+  }
+  // Drops a reference to |object| on loop |identifier|, so that if it is the
+  // last one the object is destroyed there.
+  template <typename T>
+  static void ReleaseSoon(ID identifier, const T* object) {
+    DestroySoon(identifier, &ReleaseObject<T>, object);
+  }
+
+  // RefCountedThreadSafe traits that destroy the object on loop |identifier|
+  // whichever thread drops the last reference:
+  //
+  //   class Cache : public base::RefCountedThreadSafe<
+  //       Cache, MessageLoop::DeleteOnLoop<MessageLoop::IO> > {
+  //    private:
+  //     friend struct MessageLoop::DeleteOnLoop<MessageLoop::IO>;
+  //     ~Cache();
+  //   };
+  template <ID identifier>
+  struct DeleteOnLoop {
+    template <typename T>
+    static void Destruct(const T* object) {
+      if (CurrentlyOn(identifier))
+        delete object;
+      else
+        DestroySoon(identifier, &Delete<T>, object);
+    }
+  private:
+    template <typename T>
+    static void Delete(const void* object) {
+      delete static_cast<const T*>(object);
+    }
+  };
+
+  MessageLoop(ID identifier, Type type);
   ~MessageLoop();
   ID id() { return id_; }
   void Run();
   void Quit();
-  void PostandSchduleTask(const base::Closure& task, TimeDelta delayed_ms);
-  void HandleHaveWorkMessage();
-  void HandleTimerMessage(TimeTicks timer_id);
+  void PostandSchduleTask(PendingTask pending_task, TimeDelta delayed_ms);
+  void HandleHaveWorkMessage() override;
+  void HandleTimerMessage(int sequence_num) override;
+  // Runs the BLOCK_SHUTDOWN tasks still queued, including ones they post, and
+  // drops everything else.  The loop accepts no tasks afterwards.  Must be
+  // called on the loop's thread.
+  void DrainForShutdown(ShutdownStats* stats);
+  // Destroys queued tasks whose WeakPtr receiver has been invalidated.  They
+  // would otherwise keep their bound arguments alive, and delayed ones their
+  // timers armed, until their turn came.  The loop does this by itself at
+  // most once a second while it has work, and once a second while it holds
+  // delayed tasks even if it is idle.  Returns the number of tasks purged.
+  // Must be called on the loop's thread.
+  size_t PurgeCancelledTasks();
+  size_t tasks_purged() const { return tasks_purged_; }
+  // Scratch memory for the running task, reset in bulk once it returns.
+  // Nothing allocated here may outlive the task; objects needed by a task
+  // posted from it must come from the heap.
+  base::Arena* task_arena() { return &task_arena_; }
+  // Tasks accepted by PostandSchduleTask() and tasks run, counted without
+  // contention between posting threads.
+  const base::Counter& tasks_posted() const { return tasks_posted_; }
+  const base::Counter& tasks_run() const { return tasks_run_; }
+  // Length of the incoming queue, counting the new task, seen by each
+  // immediate post.
+  const base::Histogram& queue_depth() const { return queue_depth_; }
 private:
-  void InitMessageWnd();
-  ATOM atom_;
-  HWND message_hwnd_;
+  template <typename T>
+  static void DeleteObject(const void* object) {
+    delete static_cast<const T*>(object);
+  }
+  template <typename T>
+  static void ReleaseObject(const void* object) {
+    static_cast<const T*>(object)->Release();
+  }
+  static void DestroySoon(ID identifier, void (*destroy)(const void*),
+    const void* object);
+
+  void RunTask(PendingTask* pending_task);
+  void DiscardTask(PendingTask* pending_task);
+  void MaybePurgeCancelledTasks();
+  scoped_ptr<base::MessagePump> pump_;
   base::Lock tasks_lock_;
-  std::queue<base::Closure> tasks_;
-  std::queue<base::Closure> work_queue_;
-  std::map<TimeTicks, base::Closure> delayed_tasks_;
+  std::queue<PendingTask> tasks_;
+  std::queue<PendingTask> work_queue_;
+  // Keyed by a sequence number that doubles as the timer id.
+  std::map<int, PendingTask> delayed_tasks_;
+  int next_sequence_num_;
+  bool accepting_tasks_;
+  // Tasks dropped since shutdown was requested.  Loop thread only.
+  size_t tasks_skipped_;
+  // Tasks dropped under SetFastShutdown(true), never freed.
+  std::vector<PendingTask>* leaked_tasks_;
+  // Loop thread only.
+  size_t tasks_purged_;
+  TimeTicks last_purge_;
+  // Whether the sweep timer is set.  Guarded by |tasks_lock_|.
+  bool purge_timer_armed_;
+  base::Arena task_arena_;
+  // Tasks on the stack; more than one while a task runs a nested loop.
+  int task_depth_;
+  base::Counter tasks_posted_;
+  base::Counter tasks_run_;
+  base::Histogram queue_depth_;
+  base::HangWatchdog::Watch hang_watch_;
+  static BASE_THREAD_LOCAL_POD MessageLoop* current_;
   ID id_;
 };
 
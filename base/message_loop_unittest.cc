@@ -0,0 +1,93 @@
+#include "base/message_loop.h"
+
+#include <atomic>
+
+#include "base/closure.h"
+#include "base/platform_thread.h"
+#include "base/waitable_event.h"
+#include "base/weak_ptr.h"
+#include "gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// Bound to a task so that the test sees when the task is freed.
+class SignalsOnDestruction {
+public:
+  explicit SignalsOnDestruction(WaitableEvent* destroyed)
+    : destroyed_(destroyed) {
+  }
+  ~SignalsOnDestruction() {
+    destroyed_->Signal();
+  }
+
+private:
+  WaitableEvent* destroyed_;
+};
+
+class Receiver {
+public:
+  void Receive(SignalsOnDestruction* /* argument */) {}
+};
+
+// WeakPtrs are bound to a thread, so the task is cancelled on the loop's.
+void PostCancelledDelayedTask(WaitableEvent* argument_destroyed) {
+  Receiver receiver;
+  WeakPtrFactory<Receiver> weak_factory(&receiver);
+  MessageLoop::PostDelayedTask(MessageLoop::IO,
+    Bind(&Receiver::Receive, weak_factory.GetWeakPtr(),
+      Owned(new SignalsOnDestruction(argument_destroyed))), 60000);
+  weak_factory.InvalidateWeakPtrs();
+}
+
+void SleepThenSet(WaitableEvent* started, std::atomic<bool>* finished) {
+  started->Signal();
+  PlatformThread::Sleep(200);
+  finished->store(true);
+}
+
+}  // namespace
+
+TEST(MessageLoopTest, IdleLoopReleasesCancelledDelayedTask) {
+  WaitableEvent argument_destroyed(true, false);
+  MessageLoop::StartLazily(MessageLoop::IO);
+  MessageLoop::PostTask(MessageLoop::IO,
+    Bind(&PostCancelledDelayedTask, &argument_destroyed));
+  // Nothing else is posted, so only the loop's own sweep can free it.
+  EXPECT_TRUE(argument_destroyed.TimedWait(5000));
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::IO, 5000, NULL));
+}
+
+TEST(MessageLoopTest, StoppedLoopCountsDroppedPostsUntilStartedAgain) {
+  WaitableEvent ran(true, false);
+  MessageLoop::StartLazily(MessageLoop::IO);
+  MessageLoop::PostTask(MessageLoop::IO, Bind(&WaitableEvent::Signal, Unretained(&ran)));
+  EXPECT_TRUE(ran.TimedWait(5000));
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::IO, 5000, NULL));
+
+  ran.Reset();
+  MessageLoop::PostTask(MessageLoop::IO, Bind(&WaitableEvent::Signal, Unretained(&ran)));
+  MessageLoop::ShutdownStats stats;
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::IO, 5000, &stats));
+  EXPECT_EQ(1u, stats.tasks_skipped);
+  EXPECT_FALSE(ran.IsSignaled());
+
+  MessageLoop::StartLazily(MessageLoop::IO);
+  MessageLoop::PostTask(MessageLoop::IO, Bind(&WaitableEvent::Signal, Unretained(&ran)));
+  EXPECT_TRUE(ran.TimedWait(5000));
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::IO, 5000, NULL));
+}
+
+TEST(MessageLoopTest, StopWithoutTimeoutWaitsForContinueOnShutdownTask) {
+  WaitableEvent started(true, false);
+  std::atomic<bool> finished(false);
+  MessageLoop::Start(MessageLoop::IO);
+  MessageLoop::PostTask(MessageLoop::IO, MessageLoop::CONTINUE_ON_SHUTDOWN,
+    Bind(&SleepThenSet, &started, &finished));
+  EXPECT_TRUE(started.TimedWait(5000));
+  MessageLoop::Stop(MessageLoop::IO);
+  EXPECT_TRUE(finished.load());
+}
+
+}  // namespace base
@@ -0,0 +1,199 @@
+#include "base/message_pump.h"
+
+#if defined(OS_WIN)
+#include <strsafe.h>
+#endif
+
+#include "base/epoch_reclaimer.h"
+
+namespace base {
+
+MessagePumpDefault::MessagePumpDefault(Delegate* delegate)
+  : delegate_(delegate)
+  , lock_("MessagePumpDefault::lock_")
+  , work_available_(&lock_)
+  , pending_work_(0)
+  , quit_(false) {
+}
+
+MessagePumpDefault::~MessagePumpDefault() {
+}
+
+void MessagePumpDefault::Run() {
+  AutoLock locked(lock_);
+  while (!quit_) {
+    if (pending_work_) {
+      --pending_work_;
+      AutoUnlock unlocked(lock_);
+      delegate_->HandleHaveWorkMessage();
+      continue;
+    }
+    long long now = MonotonicNanoseconds();
+    if (!timers_.empty() && timers_.begin()->first <= now) {
+      int sequence_num = timers_.begin()->second;
+      timers_.erase(timers_.begin());
+      timer_deadlines_.erase(sequence_num);
+      AutoUnlock unlocked(lock_);
+      delegate_->HandleTimerMessage(sequence_num);
+      continue;
+    }
+    // Idle, so the thread does not hold up EpochReclaimer.  Going offline
+    // may free retired objects whose destructors post to this loop, so it
+    // happens without |lock_|.
+    {
+      AutoUnlock unlocked(lock_);
+      EpochReclaimer::ThreadOffline();
+    }
+    // Work may have been scheduled meanwhile.
+    if (!pending_work_ && !quit_) {
+      if (timers_.empty()) {
+        work_available_.Wait();
+      } else {
+        long long wait_ns = timers_.begin()->first - MonotonicNanoseconds();
+        if (wait_ns > 0)
+          work_available_.TimedWait(static_cast<TimeDelta>((wait_ns + 999999) / 1000000));
+      }
+    }
+    {
+      AutoUnlock unlocked(lock_);
+      EpochReclaimer::ThreadOnline();
+    }
+  }
+  quit_ = false;
+}
+
+void MessagePumpDefault::Quit() {
+  AutoLock locked(lock_);
+  quit_ = true;
+  work_available_.Signal();
+}
+
+void MessagePumpDefault::ScheduleWork() {
+  AutoLock locked(lock_);
+  ++pending_work_;
+  work_available_.Signal();
+}
+
+void MessagePumpDefault::ScheduleDelayedWork(int sequence_num, TimeDelta delay_ms) {
+  long long deadline = MonotonicNanoseconds() + delay_ms * 1000000LL;
+  AutoLock locked(lock_);
+  timers_.insert(std::make_pair(deadline, sequence_num));
+  timer_deadlines_[sequence_num] = deadline;
+  // The loop may be sleeping until a later deadline.
+  work_available_.Signal();
+}
+
+void MessagePumpDefault::CancelDelayedWork(int sequence_num) {
+  AutoLock locked(lock_);
+  std::map<int, long long>::iterator iter = timer_deadlines_.find(sequence_num);
+  if (iter == timer_deadlines_.end())
+    return;
+  timers_.erase(std::make_pair(iter->second, sequence_num));
+  timer_deadlines_.erase(iter);
+}
+
+#if defined(OS_WIN)
+
+namespace {
+
+const wchar_t kWndClassFormat[] = L"WorkThreadWindow_%p";
+
+const int kMsgHaveWork = WM_USER + 1;
+
+HMODULE GetModuleFromAddress(void* address) {
+  HMODULE instance = NULL;
+  if (!::GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+    GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+    static_cast<char*>(address),
+    &instance)) {
+  }
+  return instance;
+}
+
+// Waits for the next message with the thread offline, so that an idle loop
+// does not hold up EpochReclaimer.
+BOOL WaitForMessage(MSG* msg) {
+  EpochReclaimer::ThreadOffline();
+  BOOL result = ::GetMessage(msg, NULL, 0, 0);
+  EpochReclaimer::ThreadOnline();
+  return result;
+}
+
+}  // namespace
+
+MessagePumpForUI::MessagePumpForUI(Delegate* delegate)
+  : delegate_(delegate)
+  , atom_(0)
+  , message_hwnd_(NULL) {
+  wchar_t class_name[MAX_PATH] = {0};
+  StringCchPrintf(class_name, MAX_PATH-1, kWndClassFormat, this);
+  HINSTANCE instance = GetModuleFromAddress(&WndProcThunk);
+  WNDCLASSEX wc = {0};
+  wc.cbSize = sizeof(wc);
+  wc.lpfnWndProc = &WndProcThunk;
+  wc.hInstance = instance;
+  wc.lpszClassName = class_name;
+  atom_ = RegisterClassEx(&wc);
+
+  message_hwnd_ = CreateWindow(MAKEINTATOM(atom_), 0, 0, 0, 0, 0, 0,
+    HWND_MESSAGE, 0, instance, 0);
+  // Timer messages carry the timer id, so they find the pump through here.
+  ::SetWindowLongPtr(message_hwnd_, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+}
+
+MessagePumpForUI::~MessagePumpForUI() {
+  DestroyWindow(message_hwnd_);
+  UnregisterClass(MAKEINTATOM(atom_),
+    GetModuleFromAddress(&WndProcThunk));
+}
+
+void MessagePumpForUI::Run() {
+  BOOL bRet = FALSE;
+  MSG msg;
+  while((bRet = WaitForMessage(&msg)) != 0) {
+    if (bRet == -1) {
+      continue;
+    } else {
+      TranslateMessage(&msg);
+      DispatchMessage(&msg);
+    }
+  }
+}
+
+void MessagePumpForUI::Quit() {
+  PostQuitMessage(0);
+}
+
+void MessagePumpForUI::ScheduleWork() {
+  ::PostMessage(message_hwnd_, kMsgHaveWork, reinterpret_cast<WPARAM>(this), 0);
+}
+
+void MessagePumpForUI::ScheduleDelayedWork(int sequence_num, TimeDelta delay_ms) {
+  ::SetTimer(message_hwnd_, sequence_num, delay_ms, NULL);
+}
+
+void MessagePumpForUI::CancelDelayedWork(int sequence_num) {
+  ::KillTimer(message_hwnd_, sequence_num);
+}
+
+// static
+LRESULT CALLBACK MessagePumpForUI::WndProcThunk(HWND window_handle, UINT message,
+  WPARAM wparam, LPARAM lparam) {
+  switch (message) {
+  case kMsgHaveWork:
+    reinterpret_cast<MessagePumpForUI*>(wparam)->delegate_->HandleHaveWorkMessage();
+    break;
+  case WM_TIMER: {
+    KillTimer(window_handle, wparam);
+    MessagePumpForUI* pump = reinterpret_cast<MessagePumpForUI*>(
+      ::GetWindowLongPtr(window_handle, GWLP_USERDATA));
+    pump->delegate_->HandleTimerMessage(static_cast<int>(wparam));
+    break;
+  }
+  }
+  return ::DefWindowProc(window_handle, message, wparam, lparam);
+}
+
+#endif
+
+}  // namespace base
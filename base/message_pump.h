@@ -0,0 +1,101 @@
+#ifndef BASE_MESSAGE_PUMP_H_
+#define BASE_MESSAGE_PUMP_H_
+
+#include <stddef.h>
+#include <map>
+#include <set>
+#include <utility>
+
+#include "base/condition_variable.h"
+#include "base/lock.h"
+#include "base/time.h"
+
+namespace base {
+
+// What a MessageLoop waits on: it wakes the loop for each posted task and
+// for each delayed task once its delay has passed.  Delayed work is
+// one-shot and identified by the sequence number the loop gave it.
+class BASE_EXPORT MessagePump {
+public:
+  class BASE_EXPORT Delegate {
+  public:
+    // Called once per ScheduleWork().
+    virtual void HandleHaveWorkMessage() = 0;
+    // Called once per ScheduleDelayedWork() that was not cancelled.
+    virtual void HandleTimerMessage(int sequence_num) = 0;
+
+  protected:
+    virtual ~Delegate() {}
+  };
+
+  virtual ~MessagePump() {}
+
+  // Dispatches to the delegate until Quit().  Called on the thread that
+  // created the pump.
+  virtual void Run() = 0;
+  virtual void Quit() = 0;
+
+  // May be called on any thread.
+  virtual void ScheduleWork() = 0;
+  virtual void ScheduleDelayedWork(int sequence_num, TimeDelta delay_ms) = 0;
+  virtual void CancelDelayedWork(int sequence_num) = 0;
+};
+
+// Dispatches tasks and nothing else, waiting on a condition variable.  The
+// pump of headless loops, and of every loop on Linux.
+class BASE_EXPORT MessagePumpDefault : public MessagePump {
+public:
+  explicit MessagePumpDefault(Delegate* delegate);
+  ~MessagePumpDefault() override;
+
+  void Run() override;
+  void Quit() override;
+  void ScheduleWork() override;
+  void ScheduleDelayedWork(int sequence_num, TimeDelta delay_ms) override;
+  void CancelDelayedWork(int sequence_num) override;
+
+private:
+  Delegate* delegate_;
+  Lock lock_;
+  ConditionVariable work_available_;
+  // Guarded by |lock_|.
+  size_t pending_work_;
+  // Deadlines in MonotonicNanoseconds(), earliest first.
+  std::set<std::pair<long long, int> > timers_;
+  std::map<int, long long> timer_deadlines_;
+  bool quit_;
+
+  DISALLOW_COPY_AND_ASSIGN(MessagePumpDefault);
+};
+
+#if defined(OS_WIN)
+
+// Runs the loop on a message-only window and dispatches every other window
+// message of its thread, for loops whose thread owns windows.
+class BASE_EXPORT MessagePumpForUI : public MessagePump {
+public:
+  explicit MessagePumpForUI(Delegate* delegate);
+  ~MessagePumpForUI() override;
+
+  void Run() override;
+  void Quit() override;
+  void ScheduleWork() override;
+  void ScheduleDelayedWork(int sequence_num, TimeDelta delay_ms) override;
+  void CancelDelayedWork(int sequence_num) override;
+
+private:
+  static LRESULT CALLBACK WndProcThunk(HWND window_handle, UINT message,
+    WPARAM wparam, LPARAM lparam);
+
+  Delegate* delegate_;
+  ATOM atom_;
+  HWND message_hwnd_;
+
+  DISALLOW_COPY_AND_ASSIGN(MessagePumpForUI);
+};
+
+#endif
+
+}  // namespace base
+
+#endif
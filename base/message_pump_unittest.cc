@@ -0,0 +1,63 @@
+#include "base/message_pump.h"
+
+#include "base/closure.h"
+#include "base/epoch_reclaimer.h"
+#include "base/message_loop.h"
+#include "base/waitable_event.h"
+#include "gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+void SignalEvent(WaitableEvent* event) {
+  event->Signal();
+}
+
+// Posts back to the loop it is freed on.
+class PostsOnDestruction {
+public:
+  explicit PostsOnDestruction(WaitableEvent* posted_task_ran)
+    : posted_task_ran_(posted_task_ran) {
+  }
+  ~PostsOnDestruction() {
+    MessageLoop::PostTask(MessageLoop::IO, Bind(&SignalEvent, posted_task_ran_));
+  }
+
+private:
+  WaitableEvent* posted_task_ran_;
+};
+
+void RetireObject(WaitableEvent* posted_task_ran) {
+  EpochReclaimer::Delete(new PostsOnDestruction(posted_task_ran));
+}
+
+void CountTask(int* count) {
+  ++*count;
+}
+
+void QuitCurrentLoop() {
+  MessageLoop::current()->Quit();
+}
+
+}  // namespace
+
+TEST(MessagePumpDefaultTest, RetiredObjectFreedWhileIdleMayPostToItsLoop) {
+  WaitableEvent posted_task_ran(true, false);
+  MessageLoop::StartLazily(MessageLoop::IO);
+  MessageLoop::PostTask(MessageLoop::IO, Bind(&RetireObject, &posted_task_ran));
+  EXPECT_TRUE(posted_task_ran.TimedWait(5000));
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::IO, 5000, NULL));
+}
+
+TEST(MessagePumpDefaultTest, RunsTasksThenDelayedTasksInOrder) {
+  MessageLoop loop(MessageLoop::UI, MessageLoop::TYPE_DEFAULT);
+  int count = 0;
+  MessageLoop::PostDelayedTask(MessageLoop::UI, Bind(&QuitCurrentLoop), 50);
+  MessageLoop::PostDelayedTask(MessageLoop::UI, Bind(&CountTask, &count), 10);
+  MessageLoop::PostTask(MessageLoop::UI, Bind(&CountTask, &count));
+  loop.Run();
+  EXPECT_EQ(2, count);
+}
+
+}  // namespace base
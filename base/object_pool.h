@@ -0,0 +1,175 @@
+#ifndef BASE_OBJECT_POOL_H_
+#define BASE_OBJECT_POOL_H_
+
+#include <stddef.h>
+#include <vector>
+
+#include "base/lock.h"
+
+namespace base {
+
+// Recycles objects of a type that is created and destroyed at a high rate,
+// such as refcounted buffers and requests, instead of deleting them.  Each
+// thread keeps up to 2 * kMagazineSize idle objects of its own, so acquiring
+// and recycling on one thread takes no lock.  Past that, objects move
+// through a shared depot a magazine of kMagazineSize at a time, so objects
+// released on another thread than the one that acquired them cost one lock
+// round trip per magazine.  The depot holds at most max_idle objects and
+// deletes the rest; see Trim().
+//
+// Acquire() returns a new T or a recycled one in whatever state it was left
+// in, so reinitialize it before use.  Refcounted types recycle themselves
+// on their last Release() through ObjectPoolTraits:
+//
+//   class Buffer : public base::RefCountedThreadSafe<
+//       Buffer, base::ObjectPoolTraits<Buffer> > {
+//    private:
+//     friend class base::ObjectPool<Buffer>;
+//     ~Buffer();
+//   };
+//
+//   scoped_refptr<Buffer> buffer = base::ObjectPool<Buffer>::Acquire();
+//   buffer->Clear();
+template <typename T>
+class ObjectPool {
+public:
+  static const size_t kMagazineSize = 32;
+  static const size_t kDefaultMaxIdle = 1024;
+
+  static T* Acquire() {
+    Magazine* magazine = GetMagazine();
+    if (magazine) {
+      if (magazine->objects.empty())
+        GetDepot()->Refill(&magazine->objects);
+      if (!magazine->objects.empty()) {
+        T* object = magazine->objects.back();
+        magazine->objects.pop_back();
+        return object;
+      }
+    }
+    return new T();
+  }
+
+  static void Recycle(const T* object) {
+    T* recycled = const_cast<T*>(object);
+    Magazine* magazine = GetMagazine();
+    if (!magazine) {
+      // The thread is exiting.
+      delete recycled;
+      return;
+    }
+    magazine->objects.push_back(recycled);
+    if (magazine->objects.size() >= 2 * kMagazineSize)
+      GetDepot()->Spill(&magazine->objects);
+  }
+
+  // Lets the depot hold at most |max_idle| objects, rounded up to whole
+  // magazines, and deletes any beyond that now.  Trim(0) drops every idle
+  // object not held by a thread, e.g. under memory pressure.
+  static void Trim(size_t max_idle) {
+    GetDepot()->Trim((max_idle + kMagazineSize - 1) / kMagazineSize);
+  }
+
+private:
+  static void DeleteAll(std::vector<T*>* objects) {
+    for (size_t i = 0; i < objects->size(); ++i)
+      delete (*objects)[i];
+    objects->clear();
+  }
+
+  class Depot {
+  public:
+    Depot() : max_magazines_(kDefaultMaxIdle / kMagazineSize) {}
+
+    // Swaps a full magazine into |objects|, which must be empty.
+    void Refill(std::vector<T*>* objects) {
+      AutoLock locked(lock_);
+      if (magazines_.empty())
+        return;
+      objects->swap(magazines_.back());
+      magazines_.pop_back();
+    }
+
+    // Takes the last kMagazineSize objects of |objects|, or deletes them if
+    // the depot is full.
+    void Spill(std::vector<T*>* objects) {
+      std::vector<T*> magazine(objects->end() - kMagazineSize, objects->end());
+      objects->resize(objects->size() - kMagazineSize);
+      {
+        AutoLock locked(lock_);
+        if (magazines_.size() < max_magazines_) {
+          magazines_.push_back(std::vector<T*>());
+          magazines_.back().swap(magazine);
+        }
+      }
+      // Destructors may recycle other objects, so they run without the lock.
+      DeleteAll(&magazine);
+    }
+
+    void Trim(size_t max_magazines) {
+      std::vector<std::vector<T*> > surplus;
+      {
+        AutoLock locked(lock_);
+        max_magazines_ = max_magazines;
+        while (magazines_.size() > max_magazines_) {
+          surplus.push_back(std::vector<T*>());
+          surplus.back().swap(magazines_.back());
+          magazines_.pop_back();
+        }
+      }
+      for (size_t i = 0; i < surplus.size(); ++i)
+        DeleteAll(&surplus[i]);
+    }
+
+  private:
+    Lock lock_;
+    std::vector<std::vector<T*> > magazines_;
+    size_t max_magazines_;
+  };
+
+  struct Magazine {
+    explicit Magazine(bool* destroyed) : destroyed(destroyed) {
+      objects.reserve(2 * kMagazineSize);
+    }
+    // Hands the thread's objects to the depot at thread exit.
+    ~Magazine() {
+      *destroyed = true;
+      while (objects.size() >= kMagazineSize)
+        GetDepot()->Spill(&objects);
+      DeleteAll(&objects);
+    }
+
+    bool* destroyed;
+    std::vector<T*> objects;
+  };
+
+  // Leaked so that objects can still be recycled during static destruction.
+  static Depot* GetDepot() {
+    static Depot* depot = new Depot();
+    return depot;
+  }
+
+  // NULL once the thread's magazine has been destroyed at thread exit.
+  static Magazine* GetMagazine() {
+    static thread_local bool destroyed = false;
+    if (destroyed)
+      return NULL;
+    static thread_local Magazine magazine(&destroyed);
+    return &magazine;
+  }
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(ObjectPool);
+};
+
+// RefCountedThreadSafe traits that hand the object to its ObjectPool on the
+// last Release() instead of deleting it.
+template <typename T>
+struct ObjectPoolTraits {
+  static void Destruct(const T* object) {
+    ObjectPool<T>::Recycle(object);
+  }
+};
+
+}  // namespace base
+
+#endif
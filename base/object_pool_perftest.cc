@@ -0,0 +1,116 @@
+#include "base/object_pool.h"
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/ref_counted.h"
+#include "benchmark/benchmark.h"
+
+namespace base {
+
+namespace {
+
+const size_t kBatchSize = 256;
+// Thread 0 waits for thread 1 past this many batches in flight, so that the
+// buffers in flight stay within what the pool keeps idle.
+const size_t kMaxBatchesInFlight = 2;
+
+class PooledBuffer : public RefCountedThreadSafe<
+    PooledBuffer, ObjectPoolTraits<PooledBuffer> > {
+public:
+  static scoped_refptr<PooledBuffer> Create() {
+    return ObjectPool<PooledBuffer>::Acquire();
+  }
+
+  char bytes[256];
+
+private:
+  friend class ObjectPool<PooledBuffer>;
+  ~PooledBuffer() {}
+};
+
+// The baseline: new on acquire, delete on the last Release().
+class HeapBuffer : public RefCountedThreadSafe<HeapBuffer> {
+public:
+  static scoped_refptr<HeapBuffer> Create() {
+    return new HeapBuffer;
+  }
+
+  char bytes[256];
+
+private:
+  friend class RefCountedThreadSafe<HeapBuffer>;
+  ~HeapBuffer() {}
+};
+
+template <typename Buffer>
+void BM_AcquireRelease(benchmark::State& state) {
+  std::vector<scoped_refptr<Buffer> > buffers(kBatchSize);
+  for (auto _ : state) {
+    for (size_t i = 0; i < kBatchSize; ++i)
+      buffers[i] = Buffer::Create();
+    for (size_t i = 0; i < kBatchSize; ++i)
+      buffers[i] = NULL;
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+BENCHMARK_TEMPLATE(BM_AcquireRelease, PooledBuffer)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_AcquireRelease, HeapBuffer)->ThreadRange(1, 8)->UseRealTime();
+
+// Buffers acquired on thread 0 and released on thread 1, as with requests
+// built on one loop and finished on another.
+template <typename Buffer>
+struct Handoff {
+  typedef std::vector<scoped_refptr<Buffer> > Batch;
+  static std::mutex mutex;
+  static std::deque<Batch> batches;
+};
+template <typename Buffer>
+std::mutex Handoff<Buffer>::mutex;
+template <typename Buffer>
+std::deque<typename Handoff<Buffer>::Batch> Handoff<Buffer>::batches;
+
+template <typename Buffer>
+void BM_CrossThreadRelease(benchmark::State& state) {
+  typedef Handoff<Buffer> Shared;
+  for (auto _ : state) {
+    if (state.thread_index() == 0) {
+      typename Shared::Batch batch(kBatchSize);
+      for (size_t i = 0; i < kBatchSize; ++i)
+        batch[i] = Buffer::Create();
+      for (;;) {
+        {
+          std::lock_guard<std::mutex> locked(Shared::mutex);
+          if (Shared::batches.size() < kMaxBatchesInFlight) {
+            Shared::batches.push_back(std::move(batch));
+            break;
+          }
+        }
+        std::this_thread::yield();
+      }
+    } else {
+      typename Shared::Batch batch;
+      for (;;) {
+        {
+          std::lock_guard<std::mutex> locked(Shared::mutex);
+          if (!Shared::batches.empty()) {
+            batch.swap(Shared::batches.front());
+            Shared::batches.pop_front();
+            break;
+          }
+        }
+        std::this_thread::yield();
+      }
+      batch.clear();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+BENCHMARK_TEMPLATE(BM_CrossThreadRelease, PooledBuffer)->Threads(2)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_CrossThreadRelease, HeapBuffer)->Threads(2)->UseRealTime();
+
+}  // namespace
+
+}  // namespace base
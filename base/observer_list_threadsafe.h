@@ -0,0 +1,141 @@
+#ifndef BASE_OBSERVER_LIST_THREADSAFE_H_
+#define BASE_OBSERVER_LIST_THREADSAFE_H_
+
+#include <assert.h>
+#include <stddef.h>
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+#include <vector>
+
+#include "base/closure.h"
+#include "base/message_loop.h"
+#include "base/ref_counted.h"
+
+namespace base {
+
+// A list of observers that live on different MessageLoops, each notified on
+// its own loop.  Notify() may be called on any thread and posts a single
+// task to every loop that has observers, which then calls each of that
+// loop's observers in turn, so a notification costs one post per loop
+// rather than one per observer.
+//
+// An observer is added and removed on the loop it is notified on.  It may
+// remove itself, or any other observer of its loop, while being notified;
+// a removed observer is never called again, even by notifications already
+// posted.  Observers added while a notification runs on their loop get the
+// next one.
+//
+//   scoped_refptr<base::ObserverListThreadSafe<Observer> > observers(
+//       new base::ObserverListThreadSafe<Observer>());
+//
+//   // On the observer's loop:
+//   observers->AddObserver(this);
+//
+//   // On any thread:
+//   observers->Notify(&Observer::OnStateChanged, state);
+template <class ObserverType>
+class ObserverListThreadSafe
+  : public RefCountedThreadSafe<ObserverListThreadSafe<ObserverType> > {
+public:
+  ObserverListThreadSafe() {
+    for (int id = 0; id < MessageLoop::ID_COUNT; ++id) {
+      loops_[id].count.store(0, std::memory_order_relaxed);
+      loops_[id].notify_depth = 0;
+    }
+  }
+
+  void AddObserver(ObserverType* observer) {
+    LoopObservers& loop = CurrentLoopObservers();
+    if (std::find(loop.observers.begin(), loop.observers.end(), observer) !=
+      loop.observers.end())
+      return;
+    loop.observers.push_back(observer);
+    loop.count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void RemoveObserver(ObserverType* observer) {
+    LoopObservers& loop = CurrentLoopObservers();
+    typename std::vector<ObserverType*>::iterator iter =
+      std::find(loop.observers.begin(), loop.observers.end(), observer);
+    if (iter == loop.observers.end())
+      return;
+    // A notification running on this loop walks the vector by index, so the
+    // slot is cleared and compacted once it is done.
+    if (loop.notify_depth)
+      *iter = NULL;
+    else
+      loop.observers.erase(iter);
+    loop.count.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // Calls (observer->*method)(args...) on every observer, on its loop.  The
+  // arguments are copied once and shared by all observers.
+  template <typename Method, typename... Args>
+  void Notify(Method method, Args&&... args) {
+    Callback<void(ObserverType*)> notification = Bind(
+      &Notification<Method, typename std::decay<Args>::type...>::Run,
+      method, std::forward<Args>(args)...);
+    for (int id = 0; id < MessageLoop::ID_COUNT; ++id) {
+      if (loops_[id].count.load(std::memory_order_relaxed) == 0)
+        continue;
+      MessageLoop::PostTask(static_cast<MessageLoop::ID>(id),
+        Bind(&ObserverListThreadSafe::NotifyOnLoop, this,
+          static_cast<MessageLoop::ID>(id), notification));
+    }
+  }
+
+private:
+  friend class RefCountedThreadSafe<ObserverListThreadSafe<ObserverType> >;
+
+  template <typename Method, typename... Args>
+  struct Notification {
+    static void Run(Method method, const Args&... args, ObserverType* observer) {
+      (observer->*method)(args...);
+    }
+  };
+
+  // Touched only on its loop, apart from |count|, which lets Notify() skip
+  // loops without observers.
+  struct LoopObservers {
+    std::vector<ObserverType*> observers;
+    std::atomic<size_t> count;
+    // Notifications running on the loop; more than one if an observer spins
+    // a nested loop.
+    int notify_depth;
+  };
+
+  ~ObserverListThreadSafe() {}
+
+  LoopObservers& CurrentLoopObservers() {
+    MessageLoop* message_loop = MessageLoop::current();
+    assert(message_loop && "observers must live on a MessageLoop");
+    return loops_[message_loop->id()];
+  }
+
+  void NotifyOnLoop(MessageLoop::ID id,
+    const Callback<void(ObserverType*)>& notification) {
+    LoopObservers& loop = loops_[id];
+    size_t count = loop.observers.size();
+    ++loop.notify_depth;
+    for (size_t i = 0; i < count; ++i) {
+      ObserverType* observer = loop.observers[i];
+      if (observer)
+        notification.Run(observer);
+    }
+    if (--loop.notify_depth == 0) {
+      loop.observers.erase(
+        std::remove(loop.observers.begin(), loop.observers.end(),
+          static_cast<ObserverType*>(NULL)),
+        loop.observers.end());
+    }
+  }
+
+  LoopObservers loops_[MessageLoop::ID_COUNT];
+
+  DISALLOW_COPY_AND_ASSIGN(ObserverListThreadSafe);
+};
+
+}  // namespace base
+
+#endif
@@ -0,0 +1,159 @@
+#include "base/observer_list_threadsafe.h"
+
+#include <vector>
+
+#include "base/closure.h"
+#include "base/message_loop.h"
+#include "base/waitable_event.h"
+#include "gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+class TestObserver;
+typedef ObserverListThreadSafe<TestObserver> TestObserverList;
+
+class TestObserver {
+public:
+  TestObserver()
+    : calls_(0)
+    , observers_(NULL)
+    , remove_on_call_(NULL)
+    , log_(NULL)
+    , id_(0) {
+  }
+
+  // Calls append |id| to |log|.
+  void LogCalls(std::vector<int>* log, int id) {
+    log_ = log;
+    id_ = id;
+  }
+
+  // The next call removes |observer|, which may be this one, from
+  // |observers|.
+  void RemoveOnCall(TestObserverList* observers, TestObserver* observer) {
+    observers_ = observers;
+    remove_on_call_ = observer;
+  }
+
+  void OnNotify(int value) {
+    EXPECT_TRUE(MessageLoop::CurrentlyOn(MessageLoop::IO));
+    EXPECT_EQ(7, value);
+    ++calls_;
+    if (log_) {
+      // Runs after the rest of the notification, unless it is split into
+      // one task per observer.
+      if (log_->empty())
+        MessageLoop::PostTask(MessageLoop::IO, Bind(&AppendToLog, log_, -1));
+      log_->push_back(id_);
+    }
+    if (remove_on_call_)
+      observers_->RemoveObserver(remove_on_call_);
+  }
+
+  int calls() const { return calls_; }
+
+private:
+  static void AppendToLog(std::vector<int>* log, int id) {
+    log->push_back(id);
+  }
+
+  int calls_;
+  TestObserverList* observers_;
+  TestObserver* remove_on_call_;
+  std::vector<int>* log_;
+  int id_;
+};
+
+void AddObservers(TestObserverList* observers, TestObserver* first,
+  size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    observers->AddObserver(first + i);
+}
+
+void RemoveObserverWhenReleased(TestObserverList* observers,
+  TestObserver* observer, WaitableEvent* release) {
+  EXPECT_TRUE(release->TimedWait(5000));
+  observers->RemoveObserver(observer);
+}
+
+// Tasks run in order, so the notifications posted before this have run
+// once it returns.  |done| is auto-reset and must outlive the loop's thread:
+// Signal() may still touch it after waking this one up.
+void WaitForIO(WaitableEvent* done) {
+  MessageLoop::PostTask(MessageLoop::IO, Bind(&WaitableEvent::Signal, Unretained(done)));
+  EXPECT_TRUE(done->TimedWait(5000));
+}
+
+}  // namespace
+
+TEST(ObserverListThreadSafeTest, NotifyRunsAllObserversOfALoopInOneTask) {
+  scoped_refptr<TestObserverList> observers(new TestObserverList());
+  WaitableEvent io_done(false, false);
+  TestObserver io_observers[3];
+  std::vector<int> log;
+  for (int i = 0; i < 3; ++i)
+    io_observers[i].LogCalls(&log, i);
+  MessageLoop::StartLazily(MessageLoop::IO);
+  MessageLoop::PostTask(MessageLoop::IO,
+    Bind(&AddObservers, observers, &io_observers[0], 3));
+  WaitForIO(&io_done);
+
+  observers->Notify(&TestObserver::OnNotify, 7);
+  WaitForIO(&io_done);
+  // Again for the task the first observer posted.
+  WaitForIO(&io_done);
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::IO, 5000, NULL));
+
+  ASSERT_EQ(4u, log.size());
+  EXPECT_EQ(0, log[0]);
+  EXPECT_EQ(1, log[1]);
+  EXPECT_EQ(2, log[2]);
+  EXPECT_EQ(-1, log[3]);
+}
+
+TEST(ObserverListThreadSafeTest, ObserverRemovedDuringNotificationIsNotCalled) {
+  scoped_refptr<TestObserverList> observers(new TestObserverList());
+  WaitableEvent io_done(false, false);
+  TestObserver io_observers[3];
+  // The first observer removes itself, the second one removes the third.
+  io_observers[0].RemoveOnCall(observers.get(), &io_observers[0]);
+  io_observers[1].RemoveOnCall(observers.get(), &io_observers[2]);
+  MessageLoop::StartLazily(MessageLoop::IO);
+  MessageLoop::PostTask(MessageLoop::IO,
+    Bind(&AddObservers, observers, &io_observers[0], 3));
+  WaitForIO(&io_done);
+
+  observers->Notify(&TestObserver::OnNotify, 7);
+  observers->Notify(&TestObserver::OnNotify, 7);
+  WaitForIO(&io_done);
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::IO, 5000, NULL));
+
+  EXPECT_EQ(1, io_observers[0].calls());
+  EXPECT_EQ(2, io_observers[1].calls());
+  EXPECT_EQ(0, io_observers[2].calls());
+}
+
+TEST(ObserverListThreadSafeTest, ObserverRemovedWhileNotificationIsQueued) {
+  scoped_refptr<TestObserverList> observers(new TestObserverList());
+  WaitableEvent io_done(false, false);
+  TestObserver io_observer;
+  WaitableEvent release(true, false);
+  MessageLoop::StartLazily(MessageLoop::IO);
+  MessageLoop::PostTask(MessageLoop::IO,
+    Bind(&AddObservers, observers, &io_observer, 1));
+  WaitForIO(&io_done);
+  MessageLoop::PostTask(MessageLoop::IO,
+    Bind(&RemoveObserverWhenReleased, observers, &io_observer, &release));
+
+  // Queued behind the removal, which the notifying thread then lets run.
+  observers->Notify(&TestObserver::OnNotify, 7);
+  release.Signal();
+  WaitForIO(&io_done);
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::IO, 5000, NULL));
+
+  EXPECT_EQ(0, io_observer.calls());
+}
+
+}  // namespace base
@@ -0,0 +1,46 @@
+#include "base/once_closure.h"
+
+namespace base {
+
+OnceClosure::OnceClosure(OnceClosure&& other)
+  : ops_(other.ops_) {
+  if (ops_) {
+    ops_->relocate(&other.storage_, &storage_);
+    other.ops_ = NULL;
+  }
+}
+
+OnceClosure& OnceClosure::operator=(OnceClosure&& other) {
+  if (this != &other) {
+    Reset();
+    ops_ = other.ops_;
+    if (ops_) {
+      ops_->relocate(&other.storage_, &storage_);
+      other.ops_ = NULL;
+    }
+  }
+  return *this;
+}
+
+OnceClosure::~OnceClosure() {
+  Reset();
+}
+
+bool OnceClosure::IsCancelled() const {
+  return ops_ && ops_->is_cancelled(&storage_);
+}
+
+void OnceClosure::Reset() {
+  if (ops_) {
+    const internal::OnceClosureOps* ops = ops_;
+    ops_ = NULL;
+    ops->destroy(&storage_);
+  }
+}
+
+void OnceClosure::Run() {
+  ops_->invoke(&storage_);
+  Reset();
+}
+
+}  // namespace base
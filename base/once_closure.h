@@ -0,0 +1,254 @@
+#ifndef BASE_ONCE_CLOSURE_H_
+#define BASE_ONCE_CLOSURE_H_
+
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "base/closure.h"
+#include "base/pool_allocator.h"
+
+namespace base {
+
+class OnceClosure;
+
+namespace internal {
+
+// How a OnceClosure drives the callable it holds.
+struct OnceClosureOps {
+  void (*invoke)(void* storage);
+  // Moves the callable from |from| to |to|, leaving |from| as raw memory.
+  void (*relocate)(void* from, void* to);
+  void (*destroy)(void* storage);
+  bool (*is_cancelled)(const void* storage);
+};
+
+// Plain callables are never cancelled; see the overloads for the callables
+// that can be further down.
+template <typename F>
+bool IsCancelledCallable(const F&) { return false; }
+
+// Callables that fit live directly in the closure's storage.
+template <typename F>
+struct InlineOps {
+  static void Invoke(void* storage) {
+    (*static_cast<F*>(storage))();
+  }
+  static void Relocate(void* from, void* to) {
+    F* source = static_cast<F*>(from);
+    new (to) F(std::move(*source));
+    source->~F();
+  }
+  static void Destroy(void* storage) {
+    static_cast<F*>(storage)->~F();
+  }
+  static bool IsCancelled(const void* storage) {
+    return IsCancelledCallable(*static_cast<const F*>(storage));
+  }
+  static const OnceClosureOps kOps;
+};
+
+template <typename F>
+const OnceClosureOps InlineOps<F>::kOps = { &Invoke, &Relocate, &Destroy, &IsCancelled };
+
+// Larger ones live in a pool block and the storage holds the pointer.
+template <typename F>
+struct OutOfLineOps {
+  static F* Get(void* storage) {
+    return *static_cast<F**>(storage);
+  }
+  static void Invoke(void* storage) {
+    (*Get(storage))();
+  }
+  static void Relocate(void* from, void* to) {
+    *static_cast<F**>(to) = Get(from);
+  }
+  static void Destroy(void* storage) {
+    F* callable = Get(storage);
+    callable->~F();
+    PoolAllocator::Free(callable, sizeof(F));
+  }
+  static bool IsCancelled(const void* storage) {
+    return IsCancelledCallable(**static_cast<F* const*>(storage));
+  }
+  static const OnceClosureOps kOps;
+};
+
+template <typename F>
+const OnceClosureOps OutOfLineOps<F>::kOps = { &Invoke, &Relocate, &Destroy, &IsCancelled };
+
+// Lets a Callback that takes no arguments ride in a OnceClosure; its result,
+// if any, is dropped.
+template <typename R>
+struct CallbackRunner {
+  explicit CallbackRunner(const Callback<R()>& callback) : callback(callback) {}
+  explicit CallbackRunner(Callback<R()>&& callback) : callback(std::move(callback)) {}
+  void operator()() { callback.Run(); }
+  Callback<R()> callback;
+};
+
+template <typename R>
+bool IsCancelledCallable(const CallbackRunner<R>& runner) {
+  return runner.callback.IsCancelled();
+}
+
+template <typename F>
+struct IsClosureType : public std::is_same<F, OnceClosure> {};
+
+template <typename R, typename... Args>
+struct IsClosureType<Callback<R(Args...)> > : public std::true_type {};
+
+}  // namespace internal
+
+// A move-only closure that runs at most once.  Unlike Closure it is not
+// reference counted: moving one between queues is a plain copy of its
+// storage, and callables of up to kInlineSize bytes, which covers nearly all
+// BindOnce() results and small lambdas, need no allocation at all.  Any
+// Closure, or other Callback taking no arguments, converts to a OnceClosure,
+// so APIs taking one accept both.
+//
+//   base::OnceClosure task = base::BindOnce(&Upload, std::move(buffer));
+//   MessageLoop::PostTask(MessageLoop::IO, std::move(task));
+class BASE_EXPORT OnceClosure {
+public:
+  static const size_t kInlineSize = 48;
+
+  OnceClosure() : ops_(NULL) {}
+  template <typename R>
+  OnceClosure(const Callback<R()>& callback) : ops_(NULL) {
+    typedef internal::CallbackRunner<R> Runner;
+    if (!callback.is_null())
+      Init<Runner>(Runner(callback), FitsInline<Runner>());
+  }
+  // Takes over the callback's reference to its bind state.
+  template <typename R>
+  OnceClosure(Callback<R()>&& callback) : ops_(NULL) {
+    typedef internal::CallbackRunner<R> Runner;
+    if (!callback.is_null())
+      Init<Runner>(Runner(std::move(callback)), FitsInline<Runner>());
+  }
+  template <typename F, typename = typename std::enable_if<
+    !internal::IsClosureType<typename std::decay<F>::type>::value>::type>
+  OnceClosure(F&& callable) : ops_(NULL) {
+    typedef typename std::decay<F>::type Callable;
+    Init<Callable>(std::forward<F>(callable), FitsInline<Callable>());
+  }
+  OnceClosure(OnceClosure&& other);
+  OnceClosure& operator=(OnceClosure&& other);
+  ~OnceClosure();
+
+  bool is_null() const { return ops_ == NULL; }
+  // True once running it would do nothing: it is bound to a method through a
+  // WeakPtr that has since been invalidated.
+  bool IsCancelled() const;
+  void Reset();
+  // Runs the callable and then destroys it, leaving this closure null.
+  void Run();
+
+private:
+  typedef std::aligned_storage<kInlineSize>::type Storage;
+
+  template <typename F>
+  struct FitsInline : public std::integral_constant<bool,
+    sizeof(F) <= sizeof(Storage) && alignof(F) <= alignof(Storage)> {};
+
+  template <typename F, typename Arg>
+  void Init(Arg&& callable, std::true_type) {
+    new (&storage_) F(std::forward<Arg>(callable));
+    ops_ = &internal::InlineOps<F>::kOps;
+  }
+
+  template <typename F, typename Arg>
+  void Init(Arg&& callable, std::false_type) {
+    void* block = PoolAllocator::Allocate(sizeof(F));
+    *reinterpret_cast<F**>(&storage_) = new (block) F(std::forward<Arg>(callable));
+    ops_ = &internal::OutOfLineOps<F>::kOps;
+  }
+
+  const internal::OnceClosureOps* ops_;
+  Storage storage_;
+
+  DISALLOW_COPY_AND_ASSIGN(OnceClosure);
+};
+
+namespace internal {
+
+template <typename T>
+T* ReceiverPointer(T* object) { return object; }
+
+template <typename T>
+T* ReceiverPointer(const scoped_refptr<T>& object) { return object.get(); }
+
+template <typename T>
+T* ReceiverPointer(const WeakPtr<T>& object) { return object.get(); }
+
+template <typename Functor, typename... Args>
+void InvokeOnce(std::false_type, Functor& functor, Args&&... args) {
+  functor(std::forward<Args>(args)...);
+}
+
+// Methods take their receiver first; calls through an invalidated WeakPtr
+// are dropped, as with Bind().
+template <typename Method, typename Receiver, typename... Args>
+void InvokeOnce(std::true_type, Method method, Receiver&& receiver, Args&&... args) {
+  typedef typename std::decay<Receiver>::type ReceiverType;
+  auto object = ReceiverPointer(receiver);
+  if (IsWeakMethod<true, ReceiverType>::value && !object)
+    return;
+  (object->*method)(std::forward<Args>(args)...);
+}
+
+// The callable built by BindOnce().  Bound arguments are moved into it and
+// moved out again when it runs.
+template <typename Functor, typename... BoundArgs>
+class OnceBindState {
+public:
+  template <typename F, typename... Args>
+  explicit OnceBindState(F&& functor, Args&&... args)
+    : functor_(std::forward<F>(functor))
+    , bound_args_(std::forward<Args>(args)...) {}
+
+  void operator()() {
+    Apply(typename MakeIndexSequence<sizeof...(BoundArgs)>::Type());
+  }
+
+  bool IsCancelled() const {
+    typedef IsWeakMethod<std::is_member_function_pointer<Functor>::value,
+      BoundArgs...> IsWeakCall;
+    return CancellationTraits<IsWeakCall::value>::IsCancelled(bound_args_);
+  }
+
+private:
+  template <size_t... Indices>
+  void Apply(IndexSequence<Indices...>) {
+    InvokeOnce(std::is_member_function_pointer<Functor>(), functor_,
+      std::move(std::get<Indices>(bound_args_))...);
+  }
+
+  Functor functor_;
+  std::tuple<BoundArgs...> bound_args_;
+};
+
+template <typename Functor, typename... BoundArgs>
+bool IsCancelledCallable(const OnceBindState<Functor, BoundArgs...>& bind_state) {
+  return bind_state.IsCancelled();
+}
+
+}  // namespace internal
+
+// Binds any number of arguments to a function, functor or method for a
+// single run.  Arguments are stored by value, moved in from rvalues, and
+// handed to the callee as rvalues, so move-only types can be bound.  A raw
+// receiver pointer is not AddRef'ed; bind a scoped_refptr to keep the
+// object alive.
+template <typename Functor, typename... Args>
+OnceClosure BindOnce(Functor&& functor, Args&&... args) {
+  typedef internal::OnceBindState<typename std::decay<Functor>::type,
+    typename std::decay<Args>::type...> BindState;
+  return OnceClosure(BindState(std::forward<Functor>(functor), std::forward<Args>(args)...));
+}
+
+}  // namespace base
+
+#endif
@@ -0,0 +1,68 @@
+#include "base/once_closure.h"
+
+#include <queue>
+
+#include "base/closure.h"
+#include "benchmark/benchmark.h"
+
+namespace base {
+
+namespace {
+
+void AddTo(int* total, int value) {
+  *total += value;
+}
+
+// A task's life in MessageLoop: bound, queued, taken off the queue and run.
+// Closure is copied in and out of the queue as MessageLoop used to.
+
+void BM_ClosureBindQueueRun(benchmark::State& state) {
+  int total = 0;
+  std::queue<Closure> queue;
+  for (auto _ : state) {
+    Closure task = Bind(&AddTo, &total, 1);
+    queue.push(task);
+    Closure next = queue.front();
+    queue.pop();
+    next.Run();
+  }
+  benchmark::DoNotOptimize(total);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ClosureBindQueueRun);
+
+void BM_OnceClosureBindQueueRun(benchmark::State& state) {
+  int total = 0;
+  std::queue<OnceClosure> queue;
+  for (auto _ : state) {
+    OnceClosure task = BindOnce(&AddTo, &total, 1);
+    queue.push(std::move(task));
+    OnceClosure next = std::move(queue.front());
+    queue.pop();
+    next.Run();
+  }
+  benchmark::DoNotOptimize(total);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_OnceClosureBindQueueRun);
+
+// Captures too large to be stored inline.
+struct LargeArgument {
+  char bytes[OnceClosure::kInlineSize];
+};
+
+void TakeLarge(const LargeArgument& /* argument */) {}
+
+void BM_OnceClosureOutOfLine(benchmark::State& state) {
+  LargeArgument argument = LargeArgument();
+  for (auto _ : state) {
+    OnceClosure task = BindOnce(&TakeLarge, argument);
+    task.Run();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_OnceClosureOutOfLine);
+
+}  // namespace
+
+}  // namespace base
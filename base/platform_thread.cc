@@ -0,0 +1,125 @@
+#include "base/platform_thread.h"
+
+#if defined(OS_POSIX)
+#include <errno.h>
+#include <time.h>
+#endif
+
+namespace base {
+
+namespace {
+
+struct ThreadParams {
+  PlatformThread::ThreadMainFunction thread_main;
+  void* param;
+};
+
+#if defined(OS_WIN)
+DWORD CALLBACK ThreadFunc(void* params) {
+#elif defined(OS_POSIX)
+void* ThreadFunc(void* params) {
+#endif
+  ThreadParams* thread_params = static_cast<ThreadParams*>(params);
+  PlatformThread::ThreadMainFunction thread_main = thread_params->thread_main;
+  void* param = thread_params->param;
+  delete thread_params;
+  thread_main(param);
+  return 0;
+}
+
+}  // namespace
+
+#if defined(OS_WIN)
+
+// static
+bool PlatformThread::Create(ThreadMainFunction thread_main, void* param,
+  Handle* handle) {
+  ThreadParams* params = new ThreadParams();
+  params->thread_main = thread_main;
+  params->param = param;
+  *handle = ::CreateThread(NULL, 0, ThreadFunc, params, 0, NULL);
+  if (!*handle) {
+    delete params;
+    return false;
+  }
+  return true;
+}
+
+// static
+void PlatformThread::Join(Handle handle) {
+  ::WaitForSingleObject(handle, INFINITE);
+  ::CloseHandle(handle);
+}
+
+// static
+bool PlatformThread::TimedJoin(Handle handle, TimeDelta timeout_ms) {
+  if (::WaitForSingleObject(handle, timeout_ms) != WAIT_OBJECT_0)
+    return false;
+  ::CloseHandle(handle);
+  return true;
+}
+
+// static
+void PlatformThread::Detach(Handle handle) {
+  ::CloseHandle(handle);
+}
+
+// static
+void PlatformThread::Sleep(TimeDelta duration_ms) {
+  ::Sleep(duration_ms);
+}
+
+#elif defined(OS_POSIX)
+
+// static
+bool PlatformThread::Create(ThreadMainFunction thread_main, void* param,
+  Handle* handle) {
+  ThreadParams* params = new ThreadParams();
+  params->thread_main = thread_main;
+  params->param = param;
+  if (pthread_create(handle, NULL, ThreadFunc, params) != 0) {
+    delete params;
+    return false;
+  }
+  return true;
+}
+
+// static
+void PlatformThread::Join(Handle handle) {
+  pthread_join(handle, NULL);
+}
+
+// static
+bool PlatformThread::TimedJoin(Handle handle, TimeDelta timeout_ms) {
+  if (timeout_ms == kInfiniteTimeDelta) {
+    Join(handle);
+    return true;
+  }
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += timeout_ms / 1000;
+  deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    ++deadline.tv_sec;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  return pthread_timedjoin_np(handle, NULL, &deadline) == 0;
+}
+
+// static
+void PlatformThread::Detach(Handle handle) {
+  pthread_detach(handle);
+}
+
+// static
+void PlatformThread::Sleep(TimeDelta duration_ms) {
+  struct timespec duration;
+  duration.tv_sec = duration_ms / 1000;
+  duration.tv_nsec = (duration_ms % 1000) * 1000000L;
+  while (nanosleep(&duration, &duration) == -1 && errno == EINTR) {
+  }
+}
+
+#endif
+
+}  // namespace base
@@ -0,0 +1,42 @@
+#ifndef BASE_PLATFORM_THREAD_H_
+#define BASE_PLATFORM_THREAD_H_
+
+#if defined(OS_POSIX)
+#include <pthread.h>
+#endif
+
+#include "base/time.h"
+
+namespace base {
+
+// Starting, joining and sleeping, over CreateThread() on Windows and
+// pthreads elsewhere.
+class BASE_EXPORT PlatformThread {
+public:
+#if defined(OS_WIN)
+  typedef HANDLE Handle;
+#elif defined(OS_POSIX)
+  typedef pthread_t Handle;
+#endif
+  typedef void (*ThreadMainFunction)(void* param);
+
+  // Runs |thread_main(param)| on a new thread.  Returns false if the thread
+  // could not be created.  Every created thread must be joined or detached.
+  static bool Create(ThreadMainFunction thread_main, void* param, Handle* handle);
+  // Waits for the thread to exit.
+  static void Join(Handle handle);
+  // Waits at most |timeout_ms| for the thread to exit.  Returns false, and
+  // keeps |handle| valid, if it is still running.
+  static bool TimedJoin(Handle handle, TimeDelta timeout_ms);
+  // Lets the thread run on unjoined.
+  static void Detach(Handle handle);
+
+  static void Sleep(TimeDelta duration_ms);
+
+private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(PlatformThread);
+};
+
+}  // namespace base
+
+#endif
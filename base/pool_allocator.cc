@@ -0,0 +1,180 @@
+#include "base/pool_allocator.h"
+
+#include <new>
+
+#include "base/lock.h"
+
+namespace base {
+
+namespace {
+
+const size_t kGranularity = 16;
+const size_t kNumClasses = PoolAllocator::kMaxSize / kGranularity;
+// Blocks moved between a thread cache and the depot at a time.
+const size_t kBatchSize = 32;
+const size_t kSlabSize = 64 * 1024;
+
+struct FreeBlock {
+  FreeBlock* next;
+  // Links the batches held by the depot.
+  FreeBlock* next_batch;
+};
+
+inline size_t SizeClassOf(size_t size) {
+  return size ? (size - 1) / kGranularity : 0;
+}
+
+inline size_t BlockSize(size_t size_class) {
+  return (size_class + 1) * kGranularity;
+}
+
+struct Depot {
+  struct Bin {
+    Bin() : batches(NULL), slab_cursor(NULL), slab_end(NULL) {}
+
+    Lock lock;
+    FreeBlock* batches;
+    // Unused tail of the newest slab.
+    char* slab_cursor;
+    char* slab_end;
+  };
+
+  Bin bins[kNumClasses];
+};
+
+// Leaked so that blocks can still be freed during static destruction.
+Depot* GetDepot() {
+  static Depot* depot = new Depot();
+  return depot;
+}
+
+// Returns a NULL-terminated list of free blocks of |size_class|: a batch
+// handed in by some thread, or kBatchSize blocks carved from a slab.
+FreeBlock* TakeBatch(size_t size_class) {
+  Depot::Bin& bin = GetDepot()->bins[size_class];
+  AutoLock locked(bin.lock);
+  FreeBlock* batch = bin.batches;
+  if (batch) {
+    bin.batches = batch->next_batch;
+    return batch;
+  }
+
+  size_t block_size = BlockSize(size_class);
+  if (static_cast<size_t>(bin.slab_end - bin.slab_cursor) < block_size * kBatchSize) {
+    bin.slab_cursor = static_cast<char*>(::operator new(kSlabSize));
+    bin.slab_end = bin.slab_cursor + kSlabSize;
+  }
+  for (size_t i = 0; i < kBatchSize; ++i) {
+    FreeBlock* block = reinterpret_cast<FreeBlock*>(bin.slab_cursor);
+    bin.slab_cursor += block_size;
+    block->next = batch;
+    batch = block;
+  }
+  return batch;
+}
+
+void GiveBatch(size_t size_class, FreeBlock* batch) {
+  Depot::Bin& bin = GetDepot()->bins[size_class];
+  AutoLock locked(bin.lock);
+  batch->next_batch = bin.batches;
+  bin.batches = batch;
+}
+
+struct ThreadCache {
+  struct FreeList {
+    FreeBlock* head;
+    size_t count;
+  };
+
+  ThreadCache();
+  ~ThreadCache();
+
+  FreeList lists[kNumClasses];
+};
+
+// Set once this thread's cache has been destroyed at thread exit; blocks
+// freed after that go straight to the depot.
+thread_local bool t_cache_destroyed = false;
+
+ThreadCache::ThreadCache() {
+  for (size_t i = 0; i < kNumClasses; ++i) {
+    lists[i].head = NULL;
+    lists[i].count = 0;
+  }
+}
+
+ThreadCache::~ThreadCache() {
+  for (size_t i = 0; i < kNumClasses; ++i) {
+    if (lists[i].head)
+      GiveBatch(i, lists[i].head);
+  }
+  t_cache_destroyed = true;
+}
+
+ThreadCache* GetThreadCache() {
+  if (t_cache_destroyed)
+    return NULL;
+  static thread_local ThreadCache cache;
+  return &cache;
+}
+
+}  // namespace
+
+// static
+void* PoolAllocator::Allocate(size_t size) {
+  if (size > kMaxSize)
+    return ::operator new(size);
+
+  size_t size_class = SizeClassOf(size);
+  ThreadCache* cache = GetThreadCache();
+  if (!cache)
+    return ::operator new(BlockSize(size_class));
+
+  ThreadCache::FreeList& list = cache->lists[size_class];
+  if (!list.head) {
+    // Batches handed back at thread exit may be short, so count this one.
+    list.head = TakeBatch(size_class);
+    for (FreeBlock* block = list.head; block; block = block->next)
+      ++list.count;
+  }
+  FreeBlock* block = list.head;
+  list.head = block->next;
+  --list.count;
+  return block;
+}
+
+// static
+void PoolAllocator::Free(void* block, size_t size) {
+  if (size > kMaxSize) {
+    ::operator delete(block);
+    return;
+  }
+
+  size_t size_class = SizeClassOf(size);
+  FreeBlock* free_block = static_cast<FreeBlock*>(block);
+  ThreadCache* cache = GetThreadCache();
+  if (!cache) {
+    free_block->next = NULL;
+    GiveBatch(size_class, free_block);
+    return;
+  }
+
+  ThreadCache::FreeList& list = cache->lists[size_class];
+  free_block->next = list.head;
+  list.head = free_block;
+  if (++list.count < 2 * kBatchSize)
+    return;
+
+  // This thread frees more than it allocates, typically because it runs
+  // tasks posted from elsewhere: pass a batch on for the posting threads.
+  FreeBlock* batch = list.head;
+  FreeBlock* last = batch;
+  for (size_t i = 1; i < kBatchSize; ++i)
+    last = last->next;
+  list.head = last->next;
+  list.count -= kBatchSize;
+  last->next = NULL;
+  GiveBatch(size_class, batch);
+}
+
+}  // namespace base
@@ -0,0 +1,29 @@
+#ifndef BASE_POOL_ALLOCATOR_H_
+#define BASE_POOL_ALLOCATOR_H_
+
+#include <stddef.h>
+
+namespace base {
+
+// A size-class allocator for small, short-lived objects such as bind states.
+// Blocks come from per-thread free lists, so an allocate/free pair on one
+// thread takes no lock.  The lists are refilled from and spilled to a central
+// depot a batch at a time, so objects allocated on one thread and freed on
+// another cost one lock round trip per batch rather than one per object.
+// Memory is carved out of slabs that are never returned to the system.
+// Requests larger than kMaxSize go to the global heap.
+class BASE_EXPORT PoolAllocator {
+public:
+  static const size_t kMaxSize = 256;
+
+  static void* Allocate(size_t size);
+  // |size| must be the size that was passed to Allocate().
+  static void Free(void* block, size_t size);
+
+private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(PoolAllocator);
+};
+
+}  // namespace base
+
+#endif
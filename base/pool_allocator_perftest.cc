@@ -0,0 +1,107 @@
+#include "base/pool_allocator.h"
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/closure.h"
+#include "benchmark/benchmark.h"
+
+namespace base {
+
+namespace {
+
+const size_t kBatchSize = 256;
+
+struct PoolAllocation {
+  static void* Allocate(size_t size) { return PoolAllocator::Allocate(size); }
+  static void Free(void* block, size_t size) { PoolAllocator::Free(block, size); }
+};
+
+// The baseline: the global heap.
+struct HeapAllocation {
+  static void* Allocate(size_t size) { return ::operator new(size); }
+  static void Free(void* block, size_t /* size */) { ::operator delete(block); }
+};
+
+// Allocation rate: a batch allocated and freed on the same thread, from 1 to
+// 8 threads.  The argument is the block size.
+template <typename Allocation>
+void BM_AllocateFree(benchmark::State& state) {
+  size_t size = static_cast<size_t>(state.range(0));
+  void* blocks[kBatchSize];
+  for (auto _ : state) {
+    for (size_t i = 0; i < kBatchSize; ++i)
+      blocks[i] = Allocation::Allocate(size);
+    benchmark::DoNotOptimize(blocks);
+    for (size_t i = 0; i < kBatchSize; ++i)
+      Allocation::Free(blocks[i], size);
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+BENCHMARK_TEMPLATE(BM_AllocateFree, PoolAllocation)
+  ->Arg(32)->Arg(128)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_AllocateFree, HeapAllocation)
+  ->Arg(32)->Arg(128)->ThreadRange(1, 8)->UseRealTime();
+
+// Blocks allocated on thread 0 and freed on thread 1, as with closures
+// posted from one loop and run on another.
+template <typename Allocation>
+struct Handoff {
+  static std::mutex mutex;
+  static std::deque<std::vector<void*> > batches;
+};
+template <typename Allocation>
+std::mutex Handoff<Allocation>::mutex;
+template <typename Allocation>
+std::deque<std::vector<void*> > Handoff<Allocation>::batches;
+
+template <typename Allocation>
+void BM_CrossThreadFree(benchmark::State& state) {
+  typedef Handoff<Allocation> Shared;
+  const size_t size = 64;
+  for (auto _ : state) {
+    if (state.thread_index() == 0) {
+      std::vector<void*> batch(kBatchSize);
+      for (size_t i = 0; i < kBatchSize; ++i)
+        batch[i] = Allocation::Allocate(size);
+      std::lock_guard<std::mutex> locked(Shared::mutex);
+      Shared::batches.push_back(std::move(batch));
+    } else {
+      std::vector<void*> batch;
+      for (;;) {
+        {
+          std::lock_guard<std::mutex> locked(Shared::mutex);
+          if (!Shared::batches.empty()) {
+            batch.swap(Shared::batches.front());
+            Shared::batches.pop_front();
+            break;
+          }
+        }
+        std::this_thread::yield();
+      }
+      for (size_t i = 0; i < batch.size(); ++i)
+        Allocation::Free(batch[i], size);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+BENCHMARK_TEMPLATE(BM_CrossThreadFree, PoolAllocation)->Threads(2)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_CrossThreadFree, HeapAllocation)->Threads(2)->UseRealTime();
+
+void DoNothing(int /* value */) {}
+
+// Throughput of what the pool is for: bind states created and destroyed.
+void BM_BindAndDestroy(benchmark::State& state) {
+  for (auto _ : state) {
+    Closure closure = Bind(&DoNothing, 1);
+    benchmark::DoNotOptimize(closure);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BindAndDestroy)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
+
+}  // namespace base
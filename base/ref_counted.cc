@@ -27,9 +27,9 @@ bool RefCountedBase::Release() const {
   return false;
 }
 
-bool RefCountedThreadSafeBase::HasOneRef() const {
-  return ref_count_ == 1;
-}
+#if !defined(NDEBUG)
+std::atomic<long long> RefCountedThreadSafeBase::atomic_op_count_(0);
+#endif
 
 RefCountedThreadSafeBase::RefCountedThreadSafeBase() : ref_count_(0) {
 }
@@ -37,19 +37,6 @@ RefCountedThreadSafeBase::RefCountedThreadSafeBase() : ref_count_(0) {
 RefCountedThreadSafeBase::~RefCountedThreadSafeBase() {
 }
 
-void RefCountedThreadSafeBase::AddRef() const {
-  InterlockedExchangeAdd(reinterpret_cast<volatile LONG*>(&ref_count_),
-    static_cast<LONG>(1));
-}
-
-bool RefCountedThreadSafeBase::Release() const {
-  if (InterlockedExchangeAdd(reinterpret_cast<volatile LONG*>(&ref_count_),
-    static_cast<LONG>(-1)) == 1) {
-    return true;
-  }
-  return false;
-}
-
 }  // namespace subtle
 
 }  // namespace base
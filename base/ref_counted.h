@@ -5,7 +5,10 @@
 #ifndef BASE_REF_COUNTED_H_
 #define BASE_REF_COUNTED_H_
 
+#include <stddef.h>
+#include <atomic>
 #include <cassert>
+#include <utility>
 
 namespace base {
 
@@ -30,21 +33,49 @@ class BASE_EXPORT RefCountedBase {
   DISALLOW_COPY_AND_ASSIGN(RefCountedBase);
 };
 
+// The count operations are inline so that scoped_refptr and Closure copies
+// compile down to a single atomic instruction.  Taking a reference needs no
+// ordering: whoever copies a reference already holds one.  Dropping one is
+// acquire-release, so every write made through any reference happens before
+// the destructor runs.
 class BASE_EXPORT RefCountedThreadSafeBase {
  public:
-  bool HasOneRef() const;
+  bool HasOneRef() const {
+    return ref_count_.load(std::memory_order_acquire) == 1;
+  }
+
+#if !defined(NDEBUG)
+  // The number of AddRef and Release calls made on any object so far, for
+  // checking that hot paths hand references over instead of copying them.
+  static long long atomic_op_count() {
+    return atomic_op_count_.load(std::memory_order_relaxed);
+  }
+#endif
 
  protected:
   RefCountedThreadSafeBase();
   ~RefCountedThreadSafeBase();
 
-  void AddRef() const;
+  void AddRef() const {
+#if !defined(NDEBUG)
+    atomic_op_count_.fetch_add(1, std::memory_order_relaxed);
+#endif
+    ref_count_.fetch_add(1, std::memory_order_relaxed);
+  }
 
   // Returns true if the object should self-delete.
-  bool Release() const;
+  bool Release() const {
+#if !defined(NDEBUG)
+    atomic_op_count_.fetch_add(1, std::memory_order_relaxed);
+#endif
+    return ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
 
  private:
-  mutable int ref_count_;
+  mutable std::atomic<int> ref_count_;
+#if !defined(NDEBUG)
+  static std::atomic<long long> atomic_op_count_;
+#endif
 
   DISALLOW_COPY_AND_ASSIGN(RefCountedThreadSafeBase);
 };
@@ -197,6 +228,15 @@ class RefCountedData
 //     // now, |b| references the MyFoo object, and |a| references NULL.
 //   }
 //
+// Moving from a scoped_refptr does the same without touching the reference
+// count, which for thread-safe objects saves an atomic AddRef/Release pair:
+//
+//   {
+//     scoped_refptr<MyFoo> a = new MyFoo();
+//     scoped_refptr<MyFoo> b(std::move(a));
+//     // now, |b| references the MyFoo object, and |a| references NULL.
+//   }
+//
 // To make both |a| and |b| in the above example reference the same MyFoo
 // object, simply use the assignment operator:
 //
@@ -232,6 +272,15 @@ class scoped_refptr {
       ptr_->AddRef();
   }
 
+  scoped_refptr(scoped_refptr<T>&& r) : ptr_(r.ptr_) {
+    r.ptr_ = NULL;
+  }
+
+  template <typename U>
+  scoped_refptr(scoped_refptr<U>&& r) : ptr_(r.ptr_) {
+    r.ptr_ = NULL;
+  }
+
   ~scoped_refptr() {
     if (ptr_)
       ptr_->Release();
@@ -264,6 +313,17 @@ class scoped_refptr {
     return *this = r.get();
   }
 
+  scoped_refptr<T>& operator=(scoped_refptr<T>&& r) {
+    scoped_refptr<T>(std::move(r)).swap(*this);
+    return *this;
+  }
+
+  template <typename U>
+  scoped_refptr<T>& operator=(scoped_refptr<U>&& r) {
+    scoped_refptr<T>(std::move(r)).swap(*this);
+    return *this;
+  }
+
   void swap(T** pp) {
     T* p = ptr_;
     ptr_ = *pp;
@@ -276,6 +336,9 @@ class scoped_refptr {
 
  protected:
   T* ptr_;
+
+ private:
+  template <typename U> friend class scoped_refptr;
 };
 
 // Handy utility for creating a scoped_refptr<T> out of a T* explicitly without
@@ -0,0 +1,97 @@
+#include "base/ref_counted.h"
+
+#include <atomic>
+
+#include "base/closure.h"
+#include "benchmark/benchmark.h"
+
+namespace base {
+
+namespace {
+
+void DoNothing(int /* value */) {}
+
+// Every thread copies and destroys closures sharing one bind state, so all of
+// them update the same reference count.
+Closure* g_shared_closure = NULL;
+
+void BM_SharedClosureCopyDestroy(benchmark::State& state) {
+  if (state.thread_index() == 0)
+    g_shared_closure = new Closure(Bind(&DoNothing, 1));
+  for (auto _ : state) {
+    Closure copy(*g_shared_closure);
+    benchmark::DoNotOptimize(copy);
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) {
+    delete g_shared_closure;
+    g_shared_closure = NULL;
+  }
+}
+BENCHMARK(BM_SharedClosureCopyDestroy)->ThreadRange(1, 32)->UseRealTime();
+
+// Each thread copies its own closure, so the counts do not bounce between
+// cores.
+void BM_PrivateClosureCopyDestroy(benchmark::State& state) {
+  Closure closure = Bind(&DoNothing, 1);
+  for (auto _ : state) {
+    Closure copy(closure);
+    benchmark::DoNotOptimize(copy);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PrivateClosureCopyDestroy)->ThreadRange(1, 32)->UseRealTime();
+
+// The count as it was before: sequentially consistent and out of line.
+class OutOfLineCount {
+public:
+  OutOfLineCount() : count_(1) {}
+#if defined(__GNUC__)
+  __attribute__((noinline))
+#endif
+  void AddRef() { count_.fetch_add(1, std::memory_order_seq_cst); }
+#if defined(__GNUC__)
+  __attribute__((noinline))
+#endif
+  bool Release() { return count_.fetch_sub(1, std::memory_order_seq_cst) == 1; }
+
+private:
+  std::atomic<int> count_;
+};
+
+OutOfLineCount g_out_of_line_count;
+
+void BM_SharedOutOfLineAddRefRelease(benchmark::State& state) {
+  for (auto _ : state) {
+    g_out_of_line_count.AddRef();
+    benchmark::DoNotOptimize(g_out_of_line_count.Release());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SharedOutOfLineAddRefRelease)->ThreadRange(1, 32)->UseRealTime();
+
+class Counted : public RefCountedThreadSafe<Counted> {
+private:
+  friend class RefCountedThreadSafe<Counted>;
+  ~Counted() {}
+};
+
+void BM_SharedInlineAddRefRelease(benchmark::State& state) {
+  static Counted* counted = NULL;
+  if (state.thread_index() == 0) {
+    counted = new Counted;
+    counted->AddRef();
+  }
+  for (auto _ : state) {
+    scoped_refptr<Counted> reference(counted);
+    benchmark::DoNotOptimize(reference);
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0)
+    counted->Release();
+}
+BENCHMARK(BM_SharedInlineAddRefRelease)->ThreadRange(1, 32)->UseRealTime();
+
+}  // namespace
+
+}  // namespace base
@@ -0,0 +1,122 @@
+#include "base/ref_counted.h"
+
+#include <atomic>
+#include <utility>
+
+#include "base/closure.h"
+#include "base/once_closure.h"
+#include "base/platform_thread.h"
+#include "gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kThreads = 8;
+const int kCopiesPerThread = 20000;
+
+// Written by each thread without synchronization before it drops its last
+// reference; the destructor reads it all, so a Release() without release
+// and acquire ordering is a data race that ThreadSanitizer reports.
+class SharedRecord : public RefCountedThreadSafe<SharedRecord> {
+public:
+  explicit SharedRecord(std::atomic<int>* destructions)
+    : destructions_(destructions) {
+    for (int i = 0; i < kThreads; ++i)
+      copies_[i] = 0;
+  }
+
+  void RecordCopies(int thread, int copies) { copies_[thread] = copies; }
+
+private:
+  friend class RefCountedThreadSafe<SharedRecord>;
+  ~SharedRecord() {
+    int total = 0;
+    for (int i = 0; i < kThreads; ++i)
+      total += copies_[i];
+    EXPECT_EQ(kThreads * kCopiesPerThread, total);
+    destructions_->fetch_add(1);
+  }
+
+  int copies_[kThreads];
+  std::atomic<int>* destructions_;
+};
+
+void Touch(SharedRecord* /* record */) {}
+
+struct ThreadParams {
+  // Each thread owns one of the references the test hands out.
+  Closure closure;
+  scoped_refptr<SharedRecord> record;
+  int thread;
+};
+
+void CopyAndDestroy(void* param) {
+  ThreadParams* params = static_cast<ThreadParams*>(param);
+  int copies = 0;
+  for (int i = 0; i < kCopiesPerThread; ++i) {
+    Closure copy(params->closure);
+    scoped_refptr<SharedRecord> reference(params->record);
+    ++copies;
+  }
+  params->record->RecordCopies(params->thread, copies);
+  params->closure.Reset();
+  params->record = NULL;
+}
+
+#if !defined(NDEBUG)
+class Counted : public RefCountedThreadSafe<Counted> {
+private:
+  friend class RefCountedThreadSafe<Counted>;
+  ~Counted() {}
+};
+
+void TouchCounted(Counted* /* counted */) {}
+#endif
+
+}  // namespace
+
+TEST(RefCountedThreadSafeTest, ConcurrentCopiesDestroyOnceAfterAllWrites) {
+  std::atomic<int> destructions(0);
+  ThreadParams params[kThreads];
+  {
+    scoped_refptr<SharedRecord> record(new SharedRecord(&destructions));
+    Closure closure = Bind(&Touch, record);
+    for (int i = 0; i < kThreads; ++i) {
+      params[i].closure = closure;
+      params[i].record = record;
+      params[i].thread = i;
+    }
+  }
+  PlatformThread::Handle threads[kThreads];
+  for (int i = 0; i < kThreads; ++i)
+    ASSERT_TRUE(PlatformThread::Create(&CopyAndDestroy, &params[i], &threads[i]));
+  for (int i = 0; i < kThreads; ++i)
+    PlatformThread::Join(threads[i]);
+  EXPECT_EQ(1, destructions.load());
+}
+
+#if !defined(NDEBUG)
+// Task posting relies on references being handed over, not copied, as a
+// closure travels from Bind() through the queues to the loop that runs it.
+TEST(RefCountedThreadSafeTest, MovesDoNotTouchTheReferenceCount) {
+  scoped_refptr<Counted> counted(new Counted);
+  Closure closure = Bind(&TouchCounted, counted);
+  long long before = subtle::RefCountedThreadSafeBase::atomic_op_count();
+
+  scoped_refptr<Counted> moved_counted(std::move(counted));
+  counted = std::move(moved_counted);
+  Closure moved_closure(std::move(closure));
+  closure = std::move(moved_closure);
+  OnceClosure once(std::move(closure));
+  OnceClosure moved_once(std::move(once));
+
+  EXPECT_EQ(before, subtle::RefCountedThreadSafeBase::atomic_op_count());
+  EXPECT_TRUE(counted.get() != NULL);
+  EXPECT_TRUE(closure.is_null());
+  EXPECT_TRUE(once.is_null());
+  EXPECT_FALSE(moved_once.is_null());
+}
+#endif
+
+}  // namespace base
@@ -0,0 +1,103 @@
+#include "base/rw_lock.h"
+
+#include "base/futex.h"
+
+namespace base {
+
+#if defined(OS_WIN)
+
+RWLock::RWLock() {
+  ::InitializeSRWLock(&native_handle_);
+}
+
+RWLock::~RWLock() {
+}
+
+void RWLock::ReadAcquire() {
+  ::AcquireSRWLockShared(&native_handle_);
+}
+
+void RWLock::ReadRelease() {
+  ::ReleaseSRWLockShared(&native_handle_);
+}
+
+void RWLock::WriteAcquire() {
+  ::AcquireSRWLockExclusive(&native_handle_);
+}
+
+void RWLock::WriteRelease() {
+  ::ReleaseSRWLockExclusive(&native_handle_);
+}
+
+#elif defined(OS_LINUX)
+
+namespace {
+const int kWriterHeld = 1 << 30;
+const int kWriterWaiting = 1 << 29;
+const int kReaderMask = kWriterWaiting - 1;
+}
+
+RWLock::RWLock() : state_(0), waiters_(0) {
+}
+
+RWLock::~RWLock() {
+}
+
+void RWLock::ReadAcquire() {
+  int state = state_.load(std::memory_order_relaxed);
+  for (;;) {
+    if ((state & (kWriterHeld | kWriterWaiting)) == 0) {
+      if (state_.compare_exchange_weak(state, state + 1,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed))
+        return;
+      continue;
+    }
+    waiters_.fetch_add(1);
+    internal::FutexWait(&state_, state);
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+    state = state_.load(std::memory_order_relaxed);
+  }
+}
+
+void RWLock::ReadRelease() {
+  int previous = state_.fetch_sub(1);
+  // Only a writer can be waiting on a read-held lock, and it only needs to
+  // hear about the last reader leaving.
+  if ((previous & kReaderMask) == 1 && (previous & kWriterWaiting) &&
+      waiters_.load() > 0)
+    internal::FutexWakeAll(&state_);
+}
+
+void RWLock::WriteAcquire() {
+  int state = state_.load(std::memory_order_relaxed);
+  for (;;) {
+    if ((state & ~kWriterWaiting) == 0) {
+      // Taking the lock clears kWriterWaiting; other waiting writers set it
+      // again when they retry.
+      if (state_.compare_exchange_weak(state, kWriterHeld,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed))
+        return;
+      continue;
+    }
+    if ((state & kWriterWaiting) == 0 &&
+        !state_.compare_exchange_weak(state, state | kWriterWaiting,
+                                      std::memory_order_relaxed))
+      continue;
+    waiters_.fetch_add(1);
+    internal::FutexWait(&state_, state | kWriterWaiting);
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+    state = state_.load(std::memory_order_relaxed);
+  }
+}
+
+void RWLock::WriteRelease() {
+  state_.exchange(0);
+  if (waiters_.load() > 0)
+    internal::FutexWakeAll(&state_);
+}
+
+#endif
+
+}  // namespace base
@@ -0,0 +1,69 @@
+#ifndef BASE_RW_LOCK_H_
+#define BASE_RW_LOCK_H_
+
+#if defined(OS_POSIX)
+#include <atomic>
+#endif
+
+namespace base {
+
+// A reader-writer lock for read-mostly state.  Any number of readers may hold
+// the lock at once; a writer holds it exclusively.  Waiting writers block new
+// readers so that a steady stream of readers cannot starve them.  The lock is
+// not recursive, and a reader may not upgrade to a writer.
+class BASE_EXPORT RWLock {
+public:
+  RWLock();
+  ~RWLock();
+
+  void ReadAcquire();
+  void ReadRelease();
+
+  void WriteAcquire();
+  void WriteRelease();
+
+private:
+#if defined(OS_WIN)
+  SRWLOCK native_handle_;
+#elif defined(OS_POSIX)
+  // Futex word: reader count in the low bits plus kWriterHeld and
+  // kWriterWaiting flags, see rw_lock.cc.
+  std::atomic<int> state_;
+  // Threads sleeping on |state_|, used to skip the wake syscall.
+  std::atomic<int> waiters_;
+#endif
+
+  DISALLOW_COPY_AND_ASSIGN(RWLock);
+};
+
+class AutoReadLock {
+public:
+  explicit AutoReadLock(RWLock& lock) : lock_(lock) {
+    lock_.ReadAcquire();
+  }
+  ~AutoReadLock() {
+    lock_.ReadRelease();
+  }
+
+private:
+  RWLock& lock_;
+  DISALLOW_COPY_AND_ASSIGN(AutoReadLock);
+};
+
+class AutoWriteLock {
+public:
+  explicit AutoWriteLock(RWLock& lock) : lock_(lock) {
+    lock_.WriteAcquire();
+  }
+  ~AutoWriteLock() {
+    lock_.WriteRelease();
+  }
+
+private:
+  RWLock& lock_;
+  DISALLOW_COPY_AND_ASSIGN(AutoWriteLock);
+};
+
+}  // namespace base
+
+#endif
@@ -0,0 +1,291 @@
+#include "base/sampling_profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#if defined(OS_WIN)
+#include <dbghelp.h>
+#elif defined(OS_POSIX)
+#include <dlfcn.h>
+#endif
+
+#include "base/hang_watchdog.h"
+#include "base/lock.h"
+#include "base/platform_thread.h"
+#include "base/stack_sampler.h"
+#include "base/waitable_event.h"
+
+namespace base {
+
+namespace {
+
+struct StackKey {
+  const char* thread_name;
+  const char* function_name;
+  const char* file_name;
+  int line;
+  // Innermost first, as sampled.
+  std::vector<const void*> frames;
+
+  bool operator<(const StackKey& other) const {
+    return std::tie(thread_name, function_name, file_name, line, frames) <
+      std::tie(other.thread_name, other.function_name, other.file_name,
+        other.line, other.frames);
+  }
+};
+
+struct ProfilerState {
+  ProfilerState()
+    : dropped_samples(0)
+    , running(false)
+    , interval_ms(0)
+    , thread()
+    , stop_event(true, false) {
+  }
+
+  // Held across Start() and Stop(), so that neither runs while the other is
+  // halfway through starting or joining the sampling thread.
+  Lock control_lock;
+  Lock lock;
+  // Held while resolving symbols, which DbgHelp does not do thread-safely.
+  Lock symbols_lock;
+  // Guarded by |lock|.
+  std::map<StackKey, size_t> stacks;
+  size_t dropped_samples;
+  bool running;
+  TimeDelta interval_ms;
+  // Sampling thread only: each thread's CPU usage at its last sample.
+  // Rebuilt on every pass, so that destroyed watches drop out.
+  std::map<const HangWatchdog::Watch*, unsigned long long> cpu_usage;
+  PlatformThread::Handle thread;
+  WaitableEvent stop_event;
+};
+
+ProfilerState* GetState() {
+  static ProfilerState* state = new ProfilerState();
+  return state;
+}
+
+// One pass over the watched threads.
+struct SamplePass {
+  ProfilerState* state;
+  // The CPU usage of the threads seen by this pass.
+  std::map<const HangWatchdog::Watch*, unsigned long long> cpu_usage;
+};
+
+void SampleThread(HangWatchdog::Watch* watch, void* context) {
+  SamplePass* pass = static_cast<SamplePass*>(context);
+  ProfilerState* state = pass->state;
+  std::map<const HangWatchdog::Watch*, unsigned long long>::const_iterator
+    last_cpu_usage = state->cpu_usage.find(watch);
+  Location posted_from;
+  unsigned task_version;
+  if (!watch->GetRunningTask(&posted_from, &task_version)) {
+    if (last_cpu_usage != state->cpu_usage.end())
+      pass->cpu_usage.insert(*last_cpu_usage);
+    return;
+  }
+  unsigned long long cpu_usage = watch->sampler()->CpuUsage();
+  pass->cpu_usage[watch] = cpu_usage;
+  if (last_cpu_usage != state->cpu_usage.end() &&
+    last_cpu_usage->second == cpu_usage)
+    return;
+
+  const void* frames[StackSampler::kMaxFrames];
+  size_t frame_count = watch->sampler()->Sample(frames, StackSampler::kMaxFrames);
+  if (!frame_count)
+    return;
+
+  StackKey key;
+  key.thread_name = watch->thread_name();
+  key.function_name = posted_from.function_name();
+  key.file_name = posted_from.file_name();
+  key.line = posted_from.line();
+  key.frames.assign(frames, frames + frame_count);
+  AutoLock locked(state->lock);
+  std::map<StackKey, size_t>::iterator iter = state->stacks.find(key);
+  if (iter != state->stacks.end())
+    ++iter->second;
+  else if (state->stacks.size() < SamplingProfiler::kMaxStacks)
+    state->stacks.insert(std::make_pair(key, 1));
+  else
+    ++state->dropped_samples;
+}
+
+void SampleThreads(ProfilerState* state) {
+  SamplePass pass;
+  pass.state = state;
+  HangWatchdog::ForEachWatch(&SampleThread, &pass);
+  state->cpu_usage.swap(pass.cpu_usage);
+}
+
+// Folded stacks are split on semicolons, and their counts on the last space.
+std::string SanitizeFrameName(const char* name) {
+  std::string sanitized(name);
+  for (size_t i = 0; i < sanitized.size(); ++i) {
+    if (sanitized[i] == ';' || sanitized[i] == ' ')
+      sanitized[i] = '_';
+  }
+  return sanitized;
+}
+
+#if defined(OS_WIN)
+
+std::string FrameName(const void* address) {
+  static BOOL symbols_loaded = ::SymInitialize(::GetCurrentProcess(), NULL, TRUE);
+  char buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+  SYMBOL_INFO* symbol = reinterpret_cast<SYMBOL_INFO*>(buffer);
+  symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+  symbol->MaxNameLen = MAX_SYM_NAME;
+  DWORD64 displacement = 0;
+  if (symbols_loaded && ::SymFromAddr(::GetCurrentProcess(),
+    reinterpret_cast<DWORD64>(address), &displacement, symbol))
+    return SanitizeFrameName(symbol->Name);
+
+  // Without symbols, module and offset can still be resolved offline.
+  HMODULE module = NULL;
+  char module_path[MAX_PATH] = {0};
+  char name[MAX_PATH + 32];
+  if (::GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+    GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+    static_cast<const char*>(address), &module) &&
+    ::GetModuleFileNameA(module, module_path, MAX_PATH)) {
+    const char* module_name = strrchr(module_path, '\\');
+    snprintf(name, sizeof(name), "%s+0x%x",
+      module_name ? module_name + 1 : module_path,
+      static_cast<unsigned>(static_cast<const char*>(address) -
+        reinterpret_cast<const char*>(module)));
+  } else {
+    snprintf(name, sizeof(name), "%p", address);
+  }
+  return SanitizeFrameName(name);
+}
+
+#elif defined(OS_POSIX)
+
+std::string FrameName(const void* address) {
+  Dl_info info;
+  char name[512];
+  bool found = dladdr(address, &info) != 0;
+  if (found && info.dli_sname)
+    return SanitizeFrameName(info.dli_sname);
+  if (found && info.dli_fname) {
+    const char* module_name = strrchr(info.dli_fname, '/');
+    snprintf(name, sizeof(name), "%s+0x%lx",
+      module_name ? module_name + 1 : info.dli_fname,
+      static_cast<unsigned long>(static_cast<const char*>(address) -
+        static_cast<const char*>(info.dli_fbase)));
+  } else {
+    snprintf(name, sizeof(name), "%p", address);
+  }
+  return SanitizeFrameName(name);
+}
+
+#endif
+
+}  // namespace
+
+// static
+void SamplingProfiler::ThreadMain(void* /* param */) {
+  ProfilerState* state = GetState();
+  while (!state->stop_event.TimedWait(state->interval_ms))
+    SampleThreads(state);
+}
+
+// static
+void SamplingProfiler::Start(TimeDelta interval_ms) {
+  ProfilerState* state = GetState();
+  AutoLock control_locked(state->control_lock);
+  AutoLock locked(state->lock);
+  if (state->running)
+    return;
+  state->interval_ms = interval_ms;
+  state->cpu_usage.clear();
+  state->stop_event.Reset();
+  if (!PlatformThread::Create(&ThreadMain, NULL, &state->thread))
+    return;
+  state->running = true;
+}
+
+// static
+void SamplingProfiler::Stop() {
+  ProfilerState* state = GetState();
+  AutoLock control_locked(state->control_lock);
+  {
+    AutoLock locked(state->lock);
+    if (!state->running)
+      return;
+    state->running = false;
+  }
+  state->stop_event.Signal();
+  PlatformThread::Join(state->thread);
+}
+
+// static
+bool SamplingProfiler::IsRunning() {
+  ProfilerState* state = GetState();
+  AutoLock locked(state->lock);
+  return state->running;
+}
+
+// static
+std::string SamplingProfiler::GetFoldedStacks() {
+  ProfilerState* state = GetState();
+  std::map<StackKey, size_t> stacks;
+  {
+    AutoLock locked(state->lock);
+    stacks = state->stacks;
+  }
+  // Symbols are looked up outside the lock, once per address.  Stacks that
+  // differ only in return addresses within the same functions fold into one.
+  AutoLock symbols_locked(state->symbols_lock);
+  std::map<const void*, std::string> frame_names;
+  std::map<std::string, size_t> folded_stacks;
+  for (std::map<StackKey, size_t>::const_iterator iter = stacks.begin();
+    iter != stacks.end(); ++iter) {
+    const StackKey& key = iter->first;
+    std::string stack(key.thread_name);
+    stack += ';';
+    stack += SanitizeFrameName(
+      Location(key.function_name, key.file_name, key.line).ToString().c_str());
+    for (size_t i = key.frames.size(); i > 0; --i) {
+      const void* address = key.frames[i - 1];
+      std::map<const void*, std::string>::iterator name = frame_names.find(address);
+      if (name == frame_names.end())
+        name = frame_names.insert(std::make_pair(address, FrameName(address))).first;
+      stack += ';';
+      stack += name->second;
+    }
+    folded_stacks[stack] += iter->second;
+  }
+
+  std::string folded;
+  for (std::map<std::string, size_t>::const_iterator iter = folded_stacks.begin();
+    iter != folded_stacks.end(); ++iter) {
+    char count[24];
+    snprintf(count, sizeof(count), " %u\n", static_cast<unsigned>(iter->second));
+    folded += iter->first;
+    folded += count;
+  }
+  return folded;
+}
+
+// static
+size_t SamplingProfiler::dropped_samples() {
+  ProfilerState* state = GetState();
+  AutoLock locked(state->lock);
+  return state->dropped_samples;
+}
+
+// static
+void SamplingProfiler::Reset() {
+  ProfilerState* state = GetState();
+  AutoLock locked(state->lock);
+  state->stacks.clear();
+  state->dropped_samples = 0;
+}
+
+}  // namespace base
@@ -0,0 +1,58 @@
+#ifndef BASE_SAMPLING_PROFILER_H_
+#define BASE_SAMPLING_PROFILER_H_
+
+#include <stddef.h>
+#include <string>
+
+#include "base/time.h"
+
+namespace base {
+
+// Samples the threads watched by HangWatchdog, which include every
+// MessageLoop, to show which tasks use their CPU.  Each sample is the
+// thread's stack plus where the task it is running was posted from, so
+// time is attributed to task origins without instrumenting the tasks.
+// Samples of idle threads, and of threads that have not used any CPU since
+// their last sample, are skipped, so the counts follow CPU time rather
+// than wall time.
+//
+// A sample interrupts its thread for as long as it takes to walk its stack
+// (see StackSampler), so the profiler can be left on in production and be
+// started and stopped at any time.
+//
+//   base::SamplingProfiler::Start(base::SamplingProfiler::kDefaultIntervalMs);
+//   ...
+//   base::SamplingProfiler::Stop();
+//   WriteFile(base::SamplingProfiler::GetFoldedStacks());
+class BASE_EXPORT SamplingProfiler {
+public:
+  static const TimeDelta kDefaultIntervalMs = 10;
+  // Samples with new stacks past this many distinct ones are dropped.
+  static const size_t kMaxStacks = 16384;
+
+  // Samples every watched thread every |interval_ms|.  Does nothing if the
+  // profiler is already running.
+  static void Start(TimeDelta interval_ms);
+  // Stops sampling and waits for the sampling thread to exit.  The samples
+  // taken so far are kept.
+  static void Stop();
+  static bool IsRunning();
+
+  // The samples taken so far as folded stacks, the input of flamegraph.pl
+  // and similar tools: one line per distinct stack, with the thread name,
+  // the posting location of its task and then its frames, outermost first,
+  // separated by semicolons and followed by the sample count.
+  static std::string GetFoldedStacks();
+  static size_t dropped_samples();
+  // Discards the samples taken so far.
+  static void Reset();
+
+private:
+  static void ThreadMain(void* param);
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(SamplingProfiler);
+};
+
+}  // namespace base
+
+#endif
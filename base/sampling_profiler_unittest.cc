@@ -0,0 +1,60 @@
+#include "base/sampling_profiler.h"
+
+#include <atomic>
+#include <string>
+
+#include "base/closure.h"
+#include "base/message_loop.h"
+#include "base/platform_thread.h"
+#include "base/waitable_event.h"
+#include "gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+void Spin(std::atomic<bool>* stop, WaitableEvent* done) {
+  volatile unsigned long long iterations = 0;
+  while (!stop->load(std::memory_order_relaxed))
+    iterations = iterations + 1;
+  done->Signal();
+}
+
+}  // namespace
+
+TEST(SamplingProfilerTest, AttributesCpuBoundTaskToThreadAndPostingLocation) {
+  SamplingProfiler::Reset();
+  SamplingProfiler::Start(5);
+  MessageLoop::StartLazily(MessageLoop::IO);
+  Location posted_from = FROM_HERE;
+  std::atomic<bool> stop(false);
+  WaitableEvent done(true, false);
+  MessageLoop::PostTask(posted_from, MessageLoop::IO, Bind(&Spin, &stop, &done));
+
+  std::string expected_prefix = "IO;" + posted_from.ToString() + ";";
+  std::string folded;
+  for (int i = 0; i < 500; ++i) {
+    PlatformThread::Sleep(10);
+    folded = SamplingProfiler::GetFoldedStacks();
+    if (folded.find(expected_prefix) != std::string::npos)
+      break;
+  }
+  stop.store(true, std::memory_order_relaxed);
+  EXPECT_TRUE(done.TimedWait(5000));
+  SamplingProfiler::Stop();
+  EXPECT_FALSE(SamplingProfiler::IsRunning());
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::IO, 5000, NULL));
+
+  EXPECT_NE(std::string::npos, folded.find(expected_prefix)) << folded;
+}
+
+TEST(SamplingProfilerTest, CanBeRestarted) {
+  for (int i = 0; i < 3; ++i) {
+    SamplingProfiler::Start(1);
+    EXPECT_TRUE(SamplingProfiler::IsRunning());
+    SamplingProfiler::Stop();
+    EXPECT_FALSE(SamplingProfiler::IsRunning());
+  }
+}
+
+}  // namespace base
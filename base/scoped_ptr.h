@@ -95,6 +95,7 @@
 #include <stdlib.h>
 
 #include <algorithm>
+#include <type_traits>
 
 namespace base {
 
@@ -317,7 +318,7 @@ class scoped_ptr {
   // scoped_ptr.
   template <typename U, typename V>
   scoped_ptr& operator=(scoped_ptr<U, V> rhs) {
-    COMPILE_ASSERT(!base::is_array<U>::value, U_cannot_be_an_array);
+    static_assert(!std::is_array<U>::value, "U cannot be an array");
     impl_.TakeState(&rhs.impl_);
     return *this;
   }
@@ -0,0 +1,90 @@
+#ifndef BASE_SEQ_LOCK_H_
+#define BASE_SEQ_LOCK_H_
+
+#include <string.h>
+
+#include <atomic>
+#include <type_traits>
+
+#include "base/lock.h"
+
+namespace base {
+
+// A sequence lock publishing small POD snapshots.  Readers never write to
+// shared memory: they copy the value and retry if a writer was active while
+// they copied, so reads scale with the number of cores.  Writers are
+// serialized by an internal Lock.  Intended for values that are read very
+// often and rewritten rarely, e.g. a routing table generation or a config
+// snapshot of a few dozen bytes.  Larger or non-trivially-copyable state
+// should use RWLock instead.
+//
+//   base::SeqLock<Limits> limits_;
+//   ...
+//   Limits current = limits_.Read();
+template <typename T>
+class SeqLock {
+public:
+  SeqLock() : sequence_(0) {
+    T value = T();
+    Store(value);
+  }
+
+  explicit SeqLock(const T& value) : sequence_(0) {
+    Store(value);
+  }
+
+  T Read() const {
+    for (;;) {
+      int sequence = sequence_.load(std::memory_order_acquire);
+      if (sequence & 1) {
+        // A write is in progress.
+        continue;
+      }
+      Word words[kWordCount];
+      for (size_t i = 0; i < kWordCount; ++i)
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == sequence) {
+        T value;
+        memcpy(&value, words, sizeof(T));
+        return value;
+      }
+    }
+  }
+
+  void Write(const T& value) {
+    AutoLock locked(write_lock_);
+    int sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Store(value);
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+private:
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SeqLock values are copied bytewise");
+
+  // The value is kept as relaxed atomic words so that a reader racing with a
+  // writer reads torn data (which it then discards) instead of hitting a data
+  // race.
+  typedef size_t Word;
+  static const size_t kWordCount = (sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+  void Store(const T& value) {
+    Word words[kWordCount] = {0};
+    memcpy(words, &value, sizeof(T));
+    for (size_t i = 0; i < kWordCount; ++i)
+      words_[i].store(words[i], std::memory_order_relaxed);
+  }
+
+  std::atomic<int> sequence_;
+  std::atomic<Word> words_[kWordCount];
+  Lock write_lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(SeqLock);
+};
+
+}  // namespace base
+
+#endif
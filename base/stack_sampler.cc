@@ -0,0 +1,346 @@
+#include "base/stack_sampler.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+#if defined(OS_POSIX)
+#include <errno.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+#include "base/lock.h"
+
+namespace base {
+
+#if defined(OS_WIN)
+
+namespace {
+
+// Frames further apart than this are taken for garbage.
+const uintptr_t kMaxFrameSize = 1024 * 1024;
+
+// The used part of a sampled thread's stack, copied while it was suspended
+// so that it can be walked once the thread runs again.
+struct StackCopy {
+  // Where the copy came from: the stack pointer at the time of the sample.
+  uintptr_t original_bottom;
+  uintptr_t bottom;
+  uintptr_t top;
+
+  // |address| moved into the copy, or 0 if |size| bytes from it are not in
+  // the copy.
+  uintptr_t Rebase(uintptr_t address, size_t size) const {
+    uintptr_t rebased = address - original_bottom + bottom;
+    if (address < original_bottom || rebased > top || top - rebased < size)
+      return 0;
+    return rebased;
+  }
+};
+
+// Walks a stack copy from the registers of the thread it came from.  Runs
+// with the thread resumed: the unwinder takes the loader lock and the
+// function table lock, which the thread may have held while suspended.
+size_t WalkStack(CONTEXT* context, const StackCopy& copy, const void** frames,
+  size_t max_frames) {
+  size_t count = 0;
+#if defined(_WIN64)
+  frames[count++] = reinterpret_cast<const void*>(context->Rip);
+  // The unwinder reads saved registers and return addresses through these,
+  // so they have to point into the copy.
+  context->Rsp = copy.Rebase(context->Rsp, 0);
+  if (uintptr_t rbp = copy.Rebase(context->Rbp, 0))
+    context->Rbp = rbp;
+  while (count < max_frames && context->Rsp) {
+    DWORD64 image_base = 0;
+    PRUNTIME_FUNCTION function =
+      ::RtlLookupFunctionEntry(context->Rip, &image_base, NULL);
+    if (function) {
+      void* handler_data = NULL;
+      DWORD64 establisher_frame = 0;
+      ::RtlVirtualUnwind(UNW_FLAG_NHANDLER, image_base, context->Rip, function,
+        context, &handler_data, &establisher_frame, NULL);
+    } else {
+      // A leaf function: the return address is on top of the stack.
+      if (context->Rsp > copy.top - sizeof(context->Rip))
+        break;
+      context->Rip = *reinterpret_cast<DWORD64*>(context->Rsp);
+      context->Rsp += sizeof(context->Rip);
+    }
+    if (!context->Rip || context->Rsp < copy.bottom || context->Rsp > copy.top)
+      break;
+    frames[count++] = reinterpret_cast<const void*>(context->Rip);
+  }
+#else
+  frames[count++] = reinterpret_cast<const void*>(context->Eip);
+  uintptr_t frame = context->Ebp;
+  uintptr_t stack_pointer = context->Esp;
+  while (count < max_frames) {
+    // Each frame holds the caller's frame pointer and the return address,
+    // and lies above the one it was called from.
+    if (frame < stack_pointer || frame - stack_pointer > kMaxFrameSize ||
+      frame % sizeof(uintptr_t))
+      break;
+    const uintptr_t* record = reinterpret_cast<const uintptr_t*>(
+      copy.Rebase(frame, 2 * sizeof(uintptr_t)));
+    if (!record || !record[1])
+      break;
+    frames[count++] = reinterpret_cast<const void*>(record[1]);
+    stack_pointer = frame + 2 * sizeof(uintptr_t);
+    frame = record[0];
+  }
+#endif
+  return count;
+}
+
+uintptr_t StackPointer(const CONTEXT& context) {
+#if defined(_WIN64)
+  return context.Rsp;
+#else
+  return context.Esp;
+#endif
+}
+
+}  // namespace
+
+StackSampler::StackSampler()
+  : thread_(::OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT |
+      THREAD_QUERY_INFORMATION, FALSE, ::GetCurrentThreadId()))
+  , stack_base_(reinterpret_cast<uintptr_t>(
+      reinterpret_cast<NT_TIB*>(::NtCurrentTeb())->StackBase))
+  , stack_size_(0) {
+  // The whole reservation, so that a copy of the used part always fits.
+  MEMORY_BASIC_INFORMATION stack_memory;
+  if (::VirtualQuery(&stack_memory, &stack_memory, sizeof(stack_memory))) {
+    stack_size_ = stack_base_ -
+      reinterpret_cast<uintptr_t>(stack_memory.AllocationBase);
+  }
+}
+
+StackSampler::~StackSampler() {
+  if (thread_)
+    ::CloseHandle(thread_);
+}
+
+size_t StackSampler::Sample(const void** frames, size_t max_frames) {
+  if (!thread_ || !stack_size_ || !max_frames ||
+    ::GetThreadId(thread_) == ::GetCurrentThreadId())
+    return 0;
+  // Allocated up front: while the thread is suspended, nothing that can take
+  // a lock it might hold, such as the heap lock, may run.
+  std::vector<char> buffer(stack_size_);
+  if (::SuspendThread(thread_) == static_cast<DWORD>(-1))
+    return 0;
+  CONTEXT context = {0};
+  context.ContextFlags = CONTEXT_CONTROL | CONTEXT_INTEGER;
+  StackCopy copy = {0};
+  if (::GetThreadContext(thread_, &context)) {
+    uintptr_t stack_pointer = StackPointer(context);
+    if (stack_pointer < stack_base_ && stack_base_ - stack_pointer <= stack_size_) {
+      memcpy(&buffer[0], reinterpret_cast<const void*>(stack_pointer),
+        stack_base_ - stack_pointer);
+      copy.original_bottom = stack_pointer;
+      copy.bottom = reinterpret_cast<uintptr_t>(&buffer[0]);
+      copy.top = copy.bottom + (stack_base_ - stack_pointer);
+    }
+  }
+  ::ResumeThread(thread_);
+  if (!copy.bottom)
+    return 0;
+  return WalkStack(&context, copy, frames, max_frames);
+}
+
+unsigned long long StackSampler::CpuUsage() const {
+  ULONG64 cycles = 0;
+  if (thread_)
+    ::QueryThreadCycleTime(thread_, &cycles);
+  return cycles;
+}
+
+#elif defined(OS_POSIX)
+
+namespace {
+
+// How long Sample() waits for the thread to take the signal.
+const int kSignalTimeoutMs = 100;
+
+// The request in flight, one at a time under SampleLock().  Kept in static
+// storage rather than on the caller's stack, as a signal may arrive after
+// Sample() has given up on it.
+//
+// The thread to sample, or 0.  Claimed by whichever comes first: the
+// handler running on that thread, or Sample() giving up.  A late signal
+// finds either 0 or another thread's id and does nothing.
+std::atomic<pid_t> g_target_thread(0);
+uintptr_t g_target_stack_end = 0;
+const void* g_sampled_frames[StackSampler::kMaxFrames];
+size_t g_sampled_frame_count = 0;
+std::atomic<bool> g_sample_done(false);
+
+// The SIGPROF handler in place before ours, such as a profiler's using
+// setitimer().  Signals that are not sample requests are passed on to it.
+struct sigaction g_previous_action;
+
+pid_t CurrentThreadId() {
+  return static_cast<pid_t>(syscall(SYS_gettid));
+}
+
+// The interrupted code's program counter, frame pointer and stack pointer.
+bool GetRegisters(const ucontext_t* context, uintptr_t* pc, uintptr_t* frame,
+  uintptr_t* stack_pointer) {
+#if defined(__x86_64__)
+  *pc = context->uc_mcontext.gregs[REG_RIP];
+  *frame = context->uc_mcontext.gregs[REG_RBP];
+  *stack_pointer = context->uc_mcontext.gregs[REG_RSP];
+  return true;
+#elif defined(__i386__)
+  *pc = context->uc_mcontext.gregs[REG_EIP];
+  *frame = context->uc_mcontext.gregs[REG_EBP];
+  *stack_pointer = context->uc_mcontext.gregs[REG_ESP];
+  return true;
+#elif defined(__aarch64__)
+  *pc = context->uc_mcontext.pc;
+  *frame = context->uc_mcontext.regs[29];
+  *stack_pointer = context->uc_mcontext.sp;
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Follows the frame pointer chain, staying within the thread's stack.  Only
+// reads memory, so it is safe in a signal handler, unlike backtrace().
+size_t WalkFramePointers(uintptr_t pc, uintptr_t frame, uintptr_t stack_pointer,
+  uintptr_t stack_end, const void** frames, size_t max_frames) {
+  size_t count = 0;
+  frames[count++] = reinterpret_cast<const void*>(pc);
+  while (count < max_frames) {
+    // Each frame holds the caller's frame pointer and the return address,
+    // and lies above the one it was called from.
+    if (frame < stack_pointer || frame >= stack_end ||
+      stack_end - frame < 2 * sizeof(uintptr_t) || frame % sizeof(uintptr_t))
+      break;
+    const uintptr_t* record = reinterpret_cast<const uintptr_t*>(frame);
+    if (!record[1])
+      break;
+    frames[count++] = reinterpret_cast<const void*>(record[1]);
+    stack_pointer = frame + 2 * sizeof(uintptr_t);
+    frame = record[0];
+  }
+  return count;
+}
+
+// Hands a signal that was not a sample request to the previous handler.
+// SIGPROF's default action kills the process, so with no handler of its
+// own a stray signal is ignored instead.
+void ChainSignal(int signal, siginfo_t* info, void* context) {
+  if (g_previous_action.sa_flags & SA_SIGINFO) {
+    if (g_previous_action.sa_sigaction)
+      g_previous_action.sa_sigaction(signal, info, context);
+  } else if (g_previous_action.sa_handler != SIG_DFL &&
+    g_previous_action.sa_handler != SIG_IGN) {
+    g_previous_action.sa_handler(signal);
+  }
+}
+
+void OnSampleSignal(int signal, siginfo_t* info, void* context) {
+  int saved_errno = errno;
+  pid_t thread_id = CurrentThreadId();
+  if (!g_target_thread.compare_exchange_strong(thread_id, 0,
+    std::memory_order_acquire, std::memory_order_relaxed)) {
+    errno = saved_errno;
+    ChainSignal(signal, info, context);
+    return;
+  }
+  uintptr_t pc = 0;
+  uintptr_t frame = 0;
+  uintptr_t stack_pointer = 0;
+  g_sampled_frame_count = 0;
+  if (GetRegisters(static_cast<const ucontext_t*>(context), &pc, &frame,
+    &stack_pointer)) {
+    g_sampled_frame_count = WalkFramePointers(pc, frame, stack_pointer,
+      g_target_stack_end, g_sampled_frames, StackSampler::kMaxFrames);
+  }
+  g_sample_done.store(true, std::memory_order_release);
+  errno = saved_errno;
+}
+
+bool InstallSignalHandler() {
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = &OnSampleSignal;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  return sigaction(SIGPROF, &action, &g_previous_action) == 0;
+}
+
+// One request in flight at a time.
+Lock* SampleLock() {
+  static Lock* lock = new Lock();
+  return lock;
+}
+
+}  // namespace
+
+StackSampler::StackSampler()
+  : thread_(pthread_self())
+  , thread_id_(CurrentThreadId())
+  , stack_end_(0) {
+  static bool installed = InstallSignalHandler();
+  (void)installed;
+  pthread_attr_t attributes;
+  if (pthread_getattr_np(thread_, &attributes) == 0) {
+    void* stack_address = NULL;
+    size_t stack_size = 0;
+    if (pthread_attr_getstack(&attributes, &stack_address, &stack_size) == 0)
+      stack_end_ = reinterpret_cast<uintptr_t>(stack_address) + stack_size;
+    pthread_attr_destroy(&attributes);
+  }
+}
+
+StackSampler::~StackSampler() {
+}
+
+size_t StackSampler::Sample(const void** frames, size_t max_frames) {
+  if (!max_frames || !stack_end_ || pthread_equal(thread_, pthread_self()))
+    return 0;
+  AutoLock locked(*SampleLock());
+  g_target_stack_end = stack_end_;
+  g_sample_done.store(false, std::memory_order_relaxed);
+  g_target_thread.store(thread_id_, std::memory_order_release);
+  if (pthread_kill(thread_, SIGPROF) != 0) {
+    g_target_thread.store(0, std::memory_order_relaxed);
+    return 0;
+  }
+  for (int waited_ms = 0; !g_sample_done.load(std::memory_order_acquire); ++waited_ms) {
+    // Once the handler has claimed the request it is only moments from done.
+    pid_t thread_id = thread_id_;
+    if (waited_ms >= kSignalTimeoutMs &&
+      g_target_thread.compare_exchange_strong(thread_id, 0, std::memory_order_relaxed))
+      return 0;
+    usleep(1000);
+  }
+  size_t frame_count = g_sampled_frame_count < max_frames ?
+    g_sampled_frame_count : max_frames;
+  for (size_t i = 0; i < frame_count; ++i)
+    frames[i] = g_sampled_frames[i];
+  return frame_count;
+}
+
+unsigned long long StackSampler::CpuUsage() const {
+  clockid_t clock;
+  struct timespec usage;
+  if (pthread_getcpuclockid(thread_, &clock) != 0 ||
+    clock_gettime(clock, &usage) != 0)
+    return 0;
+  return static_cast<unsigned long long>(usage.tv_sec) * 1000000000ULL + usage.tv_nsec;
+}
+
+#endif
+
+}  // namespace base
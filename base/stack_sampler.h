@@ -0,0 +1,66 @@
+#ifndef BASE_STACK_SAMPLER_H_
+#define BASE_STACK_SAMPLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(OS_POSIX)
+#include <pthread.h>
+#include <sys/types.h>
+#endif
+
+namespace base {
+
+// Captures the call stack of a thread while it runs, from another thread.
+// Create the sampler on the thread to be sampled.
+//
+// On Windows the thread is suspended just long enough to copy its registers
+// and the used part of its stack, which are unwound once it runs again.  On
+// x86 that follows the frame pointer chain, so functions compiled without
+// frame pointers drop out of the sample.  On Linux the thread is sent
+// SIGPROF and follows its own frame pointer chain in the signal handler, so
+// the same applies there.
+//
+// On Linux a sample therefore interrupts whatever system call the thread is
+// blocked in.  The handler is installed with SA_RESTART, but nanosleep(),
+// poll(), epoll_wait(), select() and futex waits with a timeout fail with
+// EINTR regardless, so code on sampled threads must retry them.
+// PlatformThread::Sleep(), WaitableEvent, Lock and ConditionVariable do.
+// SIGPROF handlers installed before the first sampler, such as a profiler's
+// using setitimer(), still receive the signals not sent by Sample().
+class BASE_EXPORT StackSampler {
+public:
+  static const size_t kMaxFrames = 64;
+
+  StackSampler();
+  ~StackSampler();
+
+  // Fills |frames| with the sampled thread's return addresses, innermost
+  // first, and returns how many were written, or 0 if the thread could not
+  // be sampled.  Must not be called on the sampled thread.
+  size_t Sample(const void** frames, size_t max_frames);
+
+  // The CPU time the sampled thread has used so far, in cycles on Windows
+  // and nanoseconds on Linux.  Only meaningful compared with another reading
+  // for the same thread: if they are equal, it has not run in between.
+  unsigned long long CpuUsage() const;
+
+private:
+#if defined(OS_WIN)
+  HANDLE thread_;
+  uintptr_t stack_base_;
+  // Of the thread's stack reservation.
+  size_t stack_size_;
+#elif defined(OS_POSIX)
+  pthread_t thread_;
+  pid_t thread_id_;
+  // One past the highest address of the thread's stack.
+  uintptr_t stack_end_;
+#endif
+
+  DISALLOW_COPY_AND_ASSIGN(StackSampler);
+};
+
+}  // namespace base
+
+#endif
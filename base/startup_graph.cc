@@ -0,0 +1,159 @@
+#include "base/startup_graph.h"
+
+#include <assert.h>
+
+namespace base {
+
+StartupGraph::StepTiming::StepTiming()
+  : start_ns(0)
+  , end_ns(0) {
+}
+
+StartupGraph::Step::Step()
+  : name(NULL)
+  , loop(MessageLoop::UI)
+  , urgency(BACKGROUND)
+  , unfinished_dependencies(0) {
+}
+
+StartupGraph::Step::~Step() {
+}
+
+StartupGraph::StartupGraph()
+  : lock_("StartupGraph::lock_")
+  , critical_steps_(0)
+  , unfinished_critical_steps_(0)
+  , started_(false)
+  , critical_steps_done_(false)
+  , waiting_for_critical_steps_(false)
+  , wait_stopped_(false) {
+}
+
+StartupGraph::~StartupGraph() {
+}
+
+StartupGraph::StepId StartupGraph::AddStep(const char* name, MessageLoop::ID loop,
+  base::Closure task, Urgency urgency, const std::vector<StepId>& dependencies) {
+  assert(!started_ && "steps must be added before Start()");
+  StepId id = steps_.size();
+  steps_.push_back(Step());
+  Step& step = steps_.back();
+  step.name = name;
+  step.loop = loop;
+  step.task = task;
+  step.urgency = urgency;
+  step.dependencies = dependencies;
+  step.unfinished_dependencies = dependencies.size();
+  for (size_t i = 0; i < dependencies.size(); ++i) {
+    assert(dependencies[i] < id && "dependencies must be added first");
+    steps_[dependencies[i]].dependents.push_back(id);
+  }
+  if (urgency == CRITICAL)
+    ++critical_steps_;
+  return id;
+}
+
+void StartupGraph::Start() {
+  std::vector<StepId> ready;
+  {
+    AutoLock locked(lock_);
+    started_ = true;
+    unfinished_critical_steps_ = critical_steps_;
+    for (StepId id = 0; id < steps_.size(); ++id) {
+      if (!steps_[id].unfinished_dependencies)
+        ready.push_back(id);
+    }
+  }
+  for (size_t i = 0; i < ready.size(); ++i)
+    PostStep(ready[i]);
+}
+
+bool StartupGraph::RunUntilCriticalStepsDone() {
+  if (!critical_steps_)
+    return true;
+  // Run() may also return on a Quit() meant for the main loop.
+  waiting_for_critical_steps_ = true;
+  while (!critical_steps_done_ && !wait_stopped_)
+    MessageLoop::current()->Run();
+  waiting_for_critical_steps_ = false;
+  return critical_steps_done_;
+}
+
+void StartupGraph::StopWaiting() {
+  wait_stopped_ = true;
+  if (waiting_for_critical_steps_)
+    MessageLoop::current()->Quit();
+}
+
+StartupGraph::StepTiming StartupGraph::step_timing(StepId step) const {
+  AutoLock locked(lock_);
+  return steps_[step].timing;
+}
+
+std::vector<StartupGraph::StepId> StartupGraph::CriticalPath() const {
+  std::vector<StepId> path;
+  AutoLock locked(lock_);
+  long long last_end_ns = 0;
+  for (StepId id = 0; id < steps_.size(); ++id) {
+    const Step& step = steps_[id];
+    if (step.urgency == CRITICAL && step.timing.end_ns > last_end_ns) {
+      last_end_ns = step.timing.end_ns;
+      path.assign(1, id);
+    }
+  }
+  while (!path.empty()) {
+    const Step& step = steps_[path.back()];
+    if (step.dependencies.empty())
+      break;
+    StepId latest = step.dependencies[0];
+    for (size_t i = 1; i < step.dependencies.size(); ++i) {
+      if (steps_[step.dependencies[i]].timing.end_ns > steps_[latest].timing.end_ns)
+        latest = step.dependencies[i];
+    }
+    path.push_back(latest);
+  }
+  return std::vector<StepId>(path.rbegin(), path.rend());
+}
+
+void StartupGraph::PostStep(StepId step) {
+  MessageLoop::PostTask(FROM_HERE, steps_[step].loop,
+    base::Bind(&StartupGraph::RunStep, this, step));
+}
+
+void StartupGraph::RunStep(StepId step) {
+  Step& current = steps_[step];
+  {
+    AutoLock locked(lock_);
+    current.timing.start_ns = MonotonicNanoseconds();
+  }
+  current.task.Run();
+
+  std::vector<StepId> ready;
+  bool critical_steps_done = false;
+  {
+    AutoLock locked(lock_);
+    current.timing.end_ns = MonotonicNanoseconds();
+    for (size_t i = 0; i < current.dependents.size(); ++i) {
+      StepId dependent = current.dependents[i];
+      if (!--steps_[dependent].unfinished_dependencies)
+        ready.push_back(dependent);
+    }
+    if (current.urgency == CRITICAL)
+      critical_steps_done = !--unfinished_critical_steps_;
+  }
+  for (size_t i = 0; i < ready.size(); ++i)
+    PostStep(ready[i]);
+  if (critical_steps_done) {
+    MessageLoop::PostTask(FROM_HERE, MessageLoop::UI,
+      base::Bind(&StartupGraph::OnCriticalStepsDone, this));
+  }
+}
+
+void StartupGraph::OnCriticalStepsDone() {
+  critical_steps_done_ = true;
+  // A loop nested in the window setup may run this before the wait starts.
+  if (waiting_for_critical_steps_)
+    MessageLoop::current()->Quit();
+}
+
+}  // namespace base
@@ -0,0 +1,116 @@
+#ifndef BASE_STARTUP_GRAPH_H_
+#define BASE_STARTUP_GRAPH_H_
+
+#include <stddef.h>
+#include <vector>
+
+#include "base/closure.h"
+#include "base/lock.h"
+#include "base/message_loop.h"
+#include "base/ref_counted.h"
+
+namespace base {
+
+// Initialization steps with declared dependencies, each run on the loop it
+// names as soon as every step it depends on has finished, so independent
+// steps run in parallel across the loops.  The main thread runs the UI
+// loop, and with it the UI steps, until every CRITICAL step is done.
+//
+// Queued steps hold a reference to the graph, so it outlives its owner when
+// a loop is abandoned with steps still queued.
+//
+//   base::StartupGraph::StepId config = graph->AddStep("config",
+//     MessageLoop::WORKER, base::Bind(&LoadConfig), StartupGraph::CRITICAL);
+//   std::vector<base::StartupGraph::StepId> after_config(1, config);
+//   graph->AddStep("cache", MessageLoop::IO, base::Bind(&WarmCache),
+//     StartupGraph::BACKGROUND, after_config);
+class BASE_EXPORT StartupGraph
+  : public base::RefCountedThreadSafe<StartupGraph> {
+public:
+  typedef size_t StepId;
+
+  enum Urgency {
+    // Finished before the main loop starts.
+    CRITICAL,
+    // May still be running, or not yet started, once the main loop runs.
+    BACKGROUND
+  };
+
+  // When a step ran, in MonotonicNanoseconds(); 0 until then.
+  struct StepTiming {
+    StepTiming();
+    long long start_ns;
+    long long end_ns;
+  };
+
+  StartupGraph();
+
+  // Adds a step that runs |task| on loop |loop|.  |dependencies| must be
+  // ids returned by earlier calls, so the graph cannot have cycles.  Steps
+  // can only be added before Start().
+  StepId AddStep(const char* name, MessageLoop::ID loop, base::Closure task,
+    Urgency urgency,
+    const std::vector<StepId>& dependencies = std::vector<StepId>());
+
+  // Posts the steps that depend on nothing.  Called once, on the UI thread
+  // after its loop has been created.
+  void Start();
+  // Runs the UI loop until every critical step has finished, or until
+  // StopWaiting().  A Quit() of the UI loop meanwhile does not end the wait;
+  // the loop is run again.  Returns false if the steps did not all finish.
+  bool RunUntilCriticalStepsDone();
+  // Ends the wait of RunUntilCriticalStepsDone(), or makes it return at once
+  // if it has not started, so that a quit request is not held up by a hung
+  // critical step.  The steps themselves carry on.  UI thread only.
+  void StopWaiting();
+
+  size_t step_count() const { return steps_.size(); }
+  const char* step_name(StepId step) const { return steps_[step].name; }
+  MessageLoop::ID step_loop(StepId step) const { return steps_[step].loop; }
+  StepTiming step_timing(StepId step) const;
+  // The chain of steps that held up the main loop, first step first: the
+  // critical step that finished last, preceded at each step by the
+  // dependency that finished last.  Empty if there are no critical steps.
+  std::vector<StepId> CriticalPath() const;
+
+private:
+  friend class base::RefCountedThreadSafe<StartupGraph>;
+
+  struct Step {
+    Step();
+    ~Step();
+    const char* name;
+    MessageLoop::ID loop;
+    base::Closure task;
+    Urgency urgency;
+    std::vector<StepId> dependencies;
+    std::vector<StepId> dependents;
+    // Guarded by |lock_|.
+    size_t unfinished_dependencies;
+    StepTiming timing;
+  };
+
+  ~StartupGraph();
+
+  void PostStep(StepId step);
+  void RunStep(StepId step);
+  // Runs on the UI loop once the last critical step has finished.
+  void OnCriticalStepsDone();
+
+  std::vector<Step> steps_;
+  mutable Lock lock_;
+  size_t critical_steps_;
+  // Guarded by |lock_|.
+  size_t unfinished_critical_steps_;
+  bool started_;
+  // UI thread only.
+  bool critical_steps_done_;
+  bool waiting_for_critical_steps_;
+  bool wait_stopped_;
+
+  DISALLOW_COPY_AND_ASSIGN(StartupGraph);
+};
+
+}  // namespace base
+
+#endif
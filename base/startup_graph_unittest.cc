@@ -0,0 +1,124 @@
+#include "base/startup_graph.h"
+
+#include "base/closure.h"
+#include "base/platform_thread.h"
+#include "base/waitable_event.h"
+#include "gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+void QuitCurrentLoop() {
+  MessageLoop::current()->Quit();
+}
+
+void SetFlag(bool* flag) {
+  *flag = true;
+}
+
+void DoNothing() {
+}
+
+void Sleep(TimeDelta duration_ms) {
+  PlatformThread::Sleep(duration_ms);
+}
+
+void WaitForRelease(WaitableEvent* release) {
+  EXPECT_TRUE(release->TimedWait(5000));
+}
+
+}  // namespace
+
+TEST(StartupGraphTest, QuitDuringCriticalStepsDoesNotEndTheWait) {
+  MessageLoop loop(MessageLoop::UI, MessageLoop::TYPE_DEFAULT);
+  scoped_refptr<StartupGraph> graph(new StartupGraph);
+  bool second_step_ran = false;
+  StartupGraph::StepId first = graph->AddStep("quit", MessageLoop::UI,
+    Bind(&QuitCurrentLoop), StartupGraph::CRITICAL);
+  graph->AddStep("second", MessageLoop::UI, Bind(&SetFlag, &second_step_ran),
+    StartupGraph::CRITICAL, std::vector<StartupGraph::StepId>(1, first));
+  graph->Start();
+  graph->RunUntilCriticalStepsDone();
+  EXPECT_TRUE(second_step_ran);
+}
+
+TEST(StartupGraphTest, QueuedStepsKeepTheGraphAlive) {
+  MessageLoop loop(MessageLoop::UI, MessageLoop::TYPE_DEFAULT);
+  scoped_refptr<StartupGraph> graph(new StartupGraph);
+  bool step_ran = false;
+  graph->AddStep("step", MessageLoop::UI, Bind(&SetFlag, &step_ran),
+    StartupGraph::BACKGROUND);
+  graph->Start();
+  graph = NULL;
+  MessageLoop::PostTask(MessageLoop::UI, Bind(&QuitCurrentLoop));
+  loop.Run();
+  EXPECT_TRUE(step_ran);
+}
+
+// root -> slow, fast -> join, alternating between IO and WORKER.
+TEST(StartupGraphTest, CriticalPathFollowsTheLastDependencyToFinish) {
+  MessageLoop loop(MessageLoop::UI, MessageLoop::TYPE_DEFAULT);
+  MessageLoop::StartLazily(MessageLoop::IO);
+  MessageLoop::StartLazily(MessageLoop::WORKER);
+  scoped_refptr<StartupGraph> graph(new StartupGraph);
+  StartupGraph::StepId root = graph->AddStep("root", MessageLoop::WORKER,
+    Bind(&DoNothing), StartupGraph::CRITICAL);
+  std::vector<StartupGraph::StepId> after_root(1, root);
+  StartupGraph::StepId slow = graph->AddStep("slow", MessageLoop::IO,
+    Bind(&Sleep, 50), StartupGraph::CRITICAL, after_root);
+  StartupGraph::StepId fast = graph->AddStep("fast", MessageLoop::WORKER,
+    Bind(&DoNothing), StartupGraph::CRITICAL, after_root);
+  std::vector<StartupGraph::StepId> after_both;
+  after_both.push_back(fast);
+  after_both.push_back(slow);
+  StartupGraph::StepId join = graph->AddStep("join", MessageLoop::IO,
+    Bind(&DoNothing), StartupGraph::CRITICAL, after_both);
+  graph->AddStep("background", MessageLoop::WORKER, Bind(&Sleep, 100),
+    StartupGraph::BACKGROUND, after_root);
+
+  graph->Start();
+  EXPECT_TRUE(graph->RunUntilCriticalStepsDone());
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::IO, 5000, NULL));
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::WORKER, 5000, NULL));
+
+  std::vector<StartupGraph::StepId> path = graph->CriticalPath();
+  ASSERT_EQ(3u, path.size());
+  EXPECT_EQ(root, path[0]);
+  EXPECT_EQ(slow, path[1]);
+  EXPECT_EQ(join, path[2]);
+  EXPECT_LE(graph->step_timing(slow).end_ns, graph->step_timing(join).start_ns);
+  EXPECT_LE(graph->step_timing(fast).end_ns, graph->step_timing(join).start_ns);
+}
+
+TEST(StartupGraphTest, StopWaitingEndsTheWaitForAHungStep) {
+  MessageLoop loop(MessageLoop::UI, MessageLoop::TYPE_DEFAULT);
+  MessageLoop::StartLazily(MessageLoop::IO);
+  scoped_refptr<StartupGraph> graph(new StartupGraph);
+  WaitableEvent release(true, false);
+  graph->AddStep("hung", MessageLoop::IO, Bind(&WaitForRelease, &release),
+    StartupGraph::CRITICAL);
+  graph->Start();
+  MessageLoop::PostTask(MessageLoop::UI, Bind(&StartupGraph::StopWaiting, graph));
+  EXPECT_FALSE(graph->RunUntilCriticalStepsDone());
+
+  release.Signal();
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::IO, 5000, NULL));
+}
+
+TEST(StartupGraphTest, StopWaitingBeforeTheWaitMakesItReturnAtOnce) {
+  MessageLoop loop(MessageLoop::UI, MessageLoop::TYPE_DEFAULT);
+  MessageLoop::StartLazily(MessageLoop::IO);
+  scoped_refptr<StartupGraph> graph(new StartupGraph);
+  WaitableEvent release(true, false);
+  graph->AddStep("hung", MessageLoop::IO, Bind(&WaitForRelease, &release),
+    StartupGraph::CRITICAL);
+  graph->Start();
+  graph->StopWaiting();
+  EXPECT_FALSE(graph->RunUntilCriticalStepsDone());
+
+  release.Signal();
+  EXPECT_TRUE(MessageLoop::Stop(MessageLoop::IO, 5000, NULL));
+}
+
+}  // namespace base
@@ -5,26 +5,26 @@
 #ifndef BASE_THREAD_LOCAL_H_
 #define BASE_THREAD_LOCAL_H_
 
+#include "base/thread_local_storage.h"
+
 namespace base {
+// A thread-local pointer.  Get() is an inline load and version check;
+// nothing is done to the value at thread exit.
 template <typename Type>
 class ThreadLocalPointer {
 public:
-  ThreadLocalPointer() {
-    slot_ = TlsAlloc();
-  }
-  ~ThreadLocalPointer() {
-    TlsFree(slot_);
-  }
+  ThreadLocalPointer() {}
+  ~ThreadLocalPointer() {}
   Type* Get() {
-    return static_cast<Type*>(TlsGetValue(slot_));
+    return static_cast<Type*>(slot_.Get());
   }
   void Set(Type* ptr) {
-    TlsSetValue(slot_, ptr);
+    slot_.Set(ptr);
   }
 private:
-  unsigned long slot_;
+  ThreadLocalStorage::Slot slot_;
   DISALLOW_COPY_AND_ASSIGN(ThreadLocalPointer<Type>);
 };
 }
 
-#endif
+#endif
\ No newline at end of file
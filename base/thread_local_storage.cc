@@ -0,0 +1,148 @@
+#include "base/thread_local_storage.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+
+#include "base/lock.h"
+
+#if defined(OS_POSIX)
+#include <pthread.h>
+#endif
+
+namespace base {
+
+namespace internal {
+
+BASE_THREAD_LOCAL_POD
+  ThreadLocalStorageEntry t_slot_entries[kThreadLocalStorageSlots];
+
+}  // namespace internal
+
+namespace {
+
+// Destructors may set values again; give up after this many passes.
+const int kMaxDestructorPasses = 4;
+
+// The registered slots.  |version| changes only when the slot is destroyed,
+// before its index goes on the free list, so readers need no lock.
+struct SlotInfo {
+  std::atomic<ThreadLocalStorage::TLSDestructorFunc> destructor;
+  std::atomic<size_t> version;
+};
+
+SlotInfo g_slots[ThreadLocalStorage::kMaxSlots];
+// Indices below this have been handed out at least once.  Written under
+// SlotLock().
+std::atomic<size_t> g_slot_count(0);
+
+// Guards the free list and slot allocation.
+Lock* SlotLock() {
+  static Lock* lock = new Lock("ThreadLocalStorage::SlotLock");
+  return lock;
+}
+
+// Indices of destroyed slots, guarded by SlotLock().
+size_t g_free_slots[ThreadLocalStorage::kMaxSlots];
+size_t g_free_slot_count = 0;
+
+BASE_THREAD_LOCAL_POD bool t_exit_hook_registered;
+
+void RunDestructors() {
+  internal::ThreadLocalStorageEntry* entries = internal::t_slot_entries;
+  for (int pass = 0; pass < kMaxDestructorPasses; ++pass) {
+    bool ran_destructor = false;
+    size_t slot_count = g_slot_count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < slot_count; ++i) {
+      void* value = entries[i].value;
+      if (!value)
+        continue;
+      entries[i].value = NULL;
+      // Left behind by a destroyed slot.
+      if (entries[i].version != g_slots[i].version.load(std::memory_order_acquire))
+        continue;
+      ThreadLocalStorage::TLSDestructorFunc destructor =
+        g_slots[i].destructor.load(std::memory_order_acquire);
+      if (destructor) {
+        destructor(value);
+        ran_destructor = true;
+      }
+    }
+    if (!ran_destructor)
+      break;
+  }
+}
+
+#if defined(OS_WIN)
+
+void WINAPI OnThreadExit(void* value) {
+  if (value)
+    RunDestructors();
+}
+
+void RegisterThreadExitHook() {
+  static DWORD index = ::FlsAlloc(&OnThreadExit);
+  ::FlsSetValue(index, reinterpret_cast<void*>(1));
+}
+
+#elif defined(OS_POSIX)
+
+void OnThreadExit(void* /* value */) {
+  RunDestructors();
+}
+
+pthread_key_t CreateThreadExitKey() {
+  pthread_key_t key;
+  pthread_key_create(&key, &OnThreadExit);
+  return key;
+}
+
+void RegisterThreadExitHook() {
+  static pthread_key_t key = CreateThreadExitKey();
+  pthread_setspecific(key, reinterpret_cast<void*>(1));
+}
+
+#endif
+
+size_t AllocateSlot() {
+  AutoLock locked(*SlotLock());
+  if (g_free_slot_count)
+    return g_free_slots[--g_free_slot_count];
+  size_t index = g_slot_count.load(std::memory_order_relaxed);
+  if (index == ThreadLocalStorage::kMaxSlots) {
+    // Values would land in another slot's storage; there is no safe way on.
+    fprintf(stderr, "out of thread local storage slots\n");
+    abort();
+  }
+  // Values at a new index are all NULL, so RunDestructors() may see it
+  // before its destructor is set.
+  g_slot_count.store(index + 1, std::memory_order_release);
+  return index;
+}
+
+}  // namespace
+
+ThreadLocalStorage::Slot::Slot(TLSDestructorFunc destructor)
+  : index_(AllocateSlot())
+  , version_(g_slots[index_].version.load(std::memory_order_relaxed)) {
+  g_slots[index_].destructor.store(destructor, std::memory_order_release);
+}
+
+ThreadLocalStorage::Slot::~Slot() {
+  g_slots[index_].destructor.store(NULL, std::memory_order_release);
+  g_slots[index_].version.store(version_ + 1, std::memory_order_release);
+  AutoLock locked(*SlotLock());
+  g_free_slots[g_free_slot_count++] = index_;
+}
+
+void ThreadLocalStorage::Slot::Set(void* value) {
+  internal::ThreadLocalStorageEntry& entry = internal::t_slot_entries[index_];
+  entry.value = value;
+  entry.version = version_;
+  if (value && !t_exit_hook_registered) {
+    t_exit_hook_registered = true;
+    RegisterThreadExitHook();
+  }
+}
+
+}  // namespace base
@@ -0,0 +1,70 @@
+#ifndef BASE_THREAD_LOCAL_STORAGE_H_
+#define BASE_THREAD_LOCAL_STORAGE_H_
+
+#include <stddef.h>
+
+namespace base {
+
+namespace internal {
+
+const size_t kThreadLocalStorageSlots = 128;
+
+// The value one thread holds in one slot.  |version| tells a value set in a
+// slot apart from one left behind by an earlier slot with the same index.
+struct ThreadLocalStorageEntry {
+  void* value;
+  size_t version;
+};
+
+// The calling thread's slot values.  Plain, zero-initialized thread storage,
+// so reading an entry is an inline load with no first-use check.
+extern BASE_THREAD_LOCAL_POD
+  ThreadLocalStorageEntry t_slot_entries[kThreadLocalStorageSlots];
+
+}  // namespace internal
+
+// Thread-local pointers with an optional destructor that runs at thread exit
+// for each thread that left a non-NULL value in the slot.  The values live
+// in compiler thread storage; the platform's thread exit hook, a fiber-local
+// storage callback on Windows or a pthread key destructor on Linux, runs
+// the destructors.
+//
+// At most kMaxSlots slots can exist at once; creating one more aborts.  The
+// index of a destroyed slot is reused, and values other threads still hold
+// in it read as NULL from the new slot.
+//
+//   void DeleteCache(void* cache) { delete static_cast<Cache*>(cache); }
+//   base::ThreadLocalStorage::Slot g_cache_slot(&DeleteCache);
+class BASE_EXPORT ThreadLocalStorage {
+public:
+  typedef void (*TLSDestructorFunc)(void* value);
+
+  static const size_t kMaxSlots = internal::kThreadLocalStorageSlots;
+
+  class BASE_EXPORT Slot {
+  public:
+    explicit Slot(TLSDestructorFunc destructor = NULL);
+    // Values still set on other threads are no longer destroyed.
+    ~Slot();
+
+    void* Get() const {
+      const internal::ThreadLocalStorageEntry& entry =
+        internal::t_slot_entries[index_];
+      return entry.version == version_ ? entry.value : NULL;
+    }
+    void Set(void* value);
+
+  private:
+    size_t index_;
+    size_t version_;
+
+    DISALLOW_COPY_AND_ASSIGN(Slot);
+  };
+
+private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(ThreadLocalStorage);
+};
+
+}  // namespace base
+
+#endif
@@ -0,0 +1,64 @@
+#include "base/thread_local_storage.h"
+
+#include "base/platform_thread.h"
+#include "gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+int g_destroyed_values = 0;
+
+void CountDestroyedValue(void* /* value */) {
+  ++g_destroyed_values;
+}
+
+struct SetSlotParams {
+  ThreadLocalStorage::Slot* slot;
+  void* value;
+};
+
+void SetSlot(void* param) {
+  SetSlotParams* params = static_cast<SetSlotParams*>(param);
+  params->slot->Set(params->value);
+}
+
+void RunOnThread(void (*function)(void*), void* param) {
+  PlatformThread::Handle thread;
+  ASSERT_TRUE(PlatformThread::Create(function, param, &thread));
+  PlatformThread::Join(thread);
+}
+
+}  // namespace
+
+TEST(ThreadLocalStorageTest, RunsDestructorAtThreadExit) {
+  ThreadLocalStorage::Slot slot(&CountDestroyedValue);
+  int value = 0;
+  SetSlotParams params = { &slot, &value };
+  g_destroyed_values = 0;
+  RunOnThread(&SetSlot, &params);
+  EXPECT_EQ(1, g_destroyed_values);
+  EXPECT_EQ(NULL, slot.Get());
+}
+
+TEST(ThreadLocalStorageTest, ReusedSlotDoesNotSeeOldValues) {
+  int value = 0;
+  ThreadLocalStorage::Slot* old_slot = new ThreadLocalStorage::Slot;
+  old_slot->Set(&value);
+  delete old_slot;
+
+  ThreadLocalStorage::Slot slot;
+  EXPECT_EQ(NULL, slot.Get());
+  slot.Set(&value);
+  EXPECT_EQ(&value, slot.Get());
+  slot.Set(NULL);
+}
+
+TEST(ThreadLocalStorageTest, DestroyedSlotsCanBeCreatedAgainPastTheLimit) {
+  for (size_t i = 0; i < 4 * ThreadLocalStorage::kMaxSlots; ++i) {
+    ThreadLocalStorage::Slot slot;
+    EXPECT_EQ(NULL, slot.Get());
+  }
+}
+
+}  // namespace base
@@ -0,0 +1,47 @@
+#include "base/time.h"
+
+#if defined(OS_POSIX)
+#include <time.h>
+#endif
+
+namespace base {
+
+#if defined(OS_WIN)
+
+namespace {
+long long QueryFrequency() {
+  LARGE_INTEGER frequency;
+  ::QueryPerformanceFrequency(&frequency);
+  return frequency.QuadPart;
+}
+}
+
+long long MonotonicNanoseconds() {
+  static const long long frequency = QueryFrequency();
+  LARGE_INTEGER counter;
+  ::QueryPerformanceCounter(&counter);
+  // Split the conversion so the multiplication cannot overflow.
+  long long seconds = counter.QuadPart / frequency;
+  long long remainder = counter.QuadPart % frequency;
+  return seconds * 1000000000LL + remainder * 1000000000LL / frequency;
+}
+
+TimeTicks TickCount() {
+  return ::GetTickCount();
+}
+
+#elif defined(OS_POSIX)
+
+long long MonotonicNanoseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<long long>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
+
+TimeTicks TickCount() {
+  return static_cast<TimeTicks>(MonotonicNanoseconds() / 1000000);
+}
+
+#endif
+
+}  // namespace base
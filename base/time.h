@@ -0,0 +1,24 @@
+#ifndef BASE_TIME_H_
+#define BASE_TIME_H_
+
+// Delays and tick counts are expressed in milliseconds.
+typedef unsigned long TimeDelta;
+typedef unsigned long TimeTicks;
+
+// A delay that never expires; the same value as INFINITE on Windows.
+const TimeDelta kInfiniteTimeDelta = 0xFFFFFFFF;
+
+namespace base {
+
+// Reads a monotonic high-resolution clock, in nanoseconds since an
+// unspecified origin.  Only differences between two readings are meaningful.
+BASE_EXPORT long long MonotonicNanoseconds();
+
+// A millisecond tick count, the clock of TimeTicks.  Like GetTickCount(),
+// which it is on Windows, it may wrap around; subtract two readings to
+// measure time.
+BASE_EXPORT TimeTicks TickCount();
+
+}  // namespace base
+
+#endif
@@ -0,0 +1,150 @@
+#include "base/waitable_event.h"
+
+#include <assert.h>
+
+#include "base/futex.h"
+
+namespace base {
+
+#if defined(OS_WIN)
+
+WaitableEvent::WaitableEvent(bool manual_reset, bool initially_signaled)
+  : handle_(::CreateEvent(NULL, manual_reset, initially_signaled, NULL)) {
+  assert(handle_);
+}
+
+WaitableEvent::~WaitableEvent() {
+  ::CloseHandle(handle_);
+}
+
+void WaitableEvent::Reset() {
+  ::ResetEvent(handle_);
+}
+
+void WaitableEvent::Signal() {
+  ::SetEvent(handle_);
+}
+
+bool WaitableEvent::IsSignaled() {
+  return TimedWait(0);
+}
+
+void WaitableEvent::Wait() {
+  DWORD result = ::WaitForSingleObject(handle_, INFINITE);
+  assert(result == WAIT_OBJECT_0);
+}
+
+bool WaitableEvent::TimedWait(TimeDelta max_time_ms) {
+  // Keep finite timeouts from turning into INFINITE.
+  if (max_time_ms == INFINITE)
+    max_time_ms = INFINITE - 1;
+  return ::WaitForSingleObject(handle_, max_time_ms) == WAIT_OBJECT_0;
+}
+
+// static
+size_t WaitableEvent::WaitMany(WaitableEvent** waitables, size_t count) {
+  assert(count > 0 && count <= MAXIMUM_WAIT_OBJECTS);
+  HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+  for (size_t i = 0; i < count; ++i)
+    handles[i] = waitables[i]->handle();
+  DWORD result = ::WaitForMultipleObjects(static_cast<DWORD>(count), handles,
+                                          FALSE, INFINITE);
+  assert(result >= WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + count);
+  return result - WAIT_OBJECT_0;
+}
+
+#elif defined(OS_LINUX)
+
+namespace {
+// WaitMany() cannot sleep on several futex words at once, so its callers
+// sleep on this shared word instead and Signal() bumps it whenever any of
+// them is blocked.  The counter keeps Signal() syscall-free in the common
+// case where nobody is in WaitMany().
+std::atomic<int> g_wait_many_epoch(0);
+std::atomic<int> g_wait_many_waiters(0);
+}
+
+WaitableEvent::WaitableEvent(bool manual_reset, bool initially_signaled)
+  : state_(initially_signaled ? 1 : 0)
+  , waiters_(0)
+  , manual_reset_(manual_reset) {
+}
+
+WaitableEvent::~WaitableEvent() {
+}
+
+void WaitableEvent::Reset() {
+  state_.store(0, std::memory_order_relaxed);
+}
+
+void WaitableEvent::Signal() {
+  state_.store(1);
+  if (waiters_.load() > 0) {
+    if (manual_reset_)
+      internal::FutexWakeAll(&state_);
+    else
+      internal::FutexWakeOne(&state_);
+  }
+  if (g_wait_many_waiters.load() > 0) {
+    g_wait_many_epoch.fetch_add(1);
+    internal::FutexWakeAll(&g_wait_many_epoch);
+  }
+}
+
+bool WaitableEvent::IsSignaled() {
+  return TryAcquire();
+}
+
+bool WaitableEvent::TryAcquire() {
+  if (manual_reset_)
+    return state_.load(std::memory_order_acquire) == 1;
+  int expected = 1;
+  return state_.compare_exchange_strong(expected, 0,
+                                        std::memory_order_acquire);
+}
+
+void WaitableEvent::Wait() {
+  while (!TryAcquire()) {
+    waiters_.fetch_add(1);
+    internal::FutexWait(&state_, 0);
+    waiters_.fetch_sub(1);
+  }
+}
+
+bool WaitableEvent::TimedWait(TimeDelta max_time_ms) {
+  struct timespec deadline = internal::FutexDeadlineAfter(max_time_ms);
+  while (!TryAcquire()) {
+    waiters_.fetch_add(1);
+    bool woken = internal::FutexWaitUntil(&state_, 0, &deadline);
+    waiters_.fetch_sub(1);
+    if (!woken)
+      return TryAcquire();
+  }
+  return true;
+}
+
+// static
+size_t WaitableEvent::WaitMany(WaitableEvent** waitables, size_t count) {
+  assert(count > 0);
+  for (;;) {
+    for (size_t i = 0; i < count; ++i) {
+      if (waitables[i]->TryAcquire())
+        return i;
+    }
+    // Register before sampling the epoch so that a Signal() racing with the
+    // scan above either sees us and bumps the epoch, or is seen by the
+    // re-check below.
+    g_wait_many_waiters.fetch_add(1);
+    int epoch = g_wait_many_epoch.load();
+    bool any_signaled = false;
+    for (size_t i = 0; i < count && !any_signaled; ++i)
+      any_signaled = waitables[i]->state_.load() == 1;
+    if (!any_signaled)
+      internal::FutexWait(&g_wait_many_epoch, epoch);
+    g_wait_many_waiters.fetch_sub(1);
+  }
+}
+
+#endif
+
+}  // namespace base
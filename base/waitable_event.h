@@ -0,0 +1,73 @@
+#ifndef BASE_WAITABLE_EVENT_H_
+#define BASE_WAITABLE_EVENT_H_
+
+#include <stddef.h>
+
+#if defined(OS_POSIX)
+#include <atomic>
+#endif
+
+#include "base/time.h"
+
+namespace base {
+
+// A WaitableEvent can be used to block a thread until another thread
+// signals it.  A manual-reset event stays signaled until Reset() is called
+// and releases every waiter; an auto-reset event releases exactly one waiter
+// and then returns to the non-signaled state.
+//
+// Prefer a ConditionVariable when the state being waited on is guarded by a
+// Lock; WaitableEvent is for one-shot hand-offs such as "thread started" or
+// "shutdown requested".
+class BASE_EXPORT WaitableEvent {
+public:
+  WaitableEvent(bool manual_reset, bool initially_signaled);
+  ~WaitableEvent();
+
+  // Puts the event in the non-signaled state.
+  void Reset();
+
+  // Puts the event in the signaled state, waking waiters as described above.
+  void Signal();
+
+  // Returns true if the event is signaled.  For an auto-reset event a true
+  // result consumes the signal.
+  bool IsSignaled();
+
+  // Blocks until the event is signaled.
+  void Wait();
+
+  // Blocks for at most |max_time_ms|.  Returns true if the event was
+  // signaled, false on timeout.
+  bool TimedWait(TimeDelta max_time_ms);
+
+  // Blocks until one of |waitables| is signaled and returns its index.  If
+  // several are signaled the lowest index wins, and only that event has its
+  // auto-reset signal consumed.  |count| must be non-zero (and no more than
+  // MAXIMUM_WAIT_OBJECTS on Windows).
+  static size_t WaitMany(WaitableEvent** waitables, size_t count);
+
+#if defined(OS_WIN)
+  HANDLE handle() const { return handle_; }
+#endif
+
+private:
+#if defined(OS_WIN)
+  HANDLE handle_;
+#elif defined(OS_POSIX)
+  // Consumes the signal if the event is signaled; returns false otherwise.
+  bool TryAcquire();
+
+  // 1 when signaled, 0 otherwise.  This is also the futex word.
+  std::atomic<int> state_;
+  // Threads blocked in Wait()/TimedWait(), used to skip the wake syscall.
+  std::atomic<int> waiters_;
+  const bool manual_reset_;
+#endif
+
+  DISALLOW_COPY_AND_ASSIGN(WaitableEvent);
+};
+
+}  // namespace base
+
+#endif
@@ -0,0 +1,140 @@
+#include "base/waitable_event.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "base/condition_variable.h"
+#include "base/lock.h"
+#include "base/platform_thread.h"
+#include "benchmark/benchmark.h"
+
+namespace base {
+
+namespace {
+
+// Each iteration wakes a second thread, which wakes the benchmark thread
+// back, so the time per iteration is two wake-ups.
+
+struct EventPingPong {
+  EventPingPong() : ping(false, false), pong(false, false), stop(false) {}
+  WaitableEvent ping;
+  WaitableEvent pong;
+  std::atomic<bool> stop;
+};
+
+void AnswerEvents(void* param) {
+  EventPingPong* events = static_cast<EventPingPong*>(param);
+  for (;;) {
+    events->ping.Wait();
+    if (events->stop.load(std::memory_order_relaxed))
+      return;
+    events->pong.Signal();
+  }
+}
+
+void BM_WaitableEventRoundTrip(benchmark::State& state) {
+  EventPingPong events;
+  PlatformThread::Handle thread;
+  PlatformThread::Create(&AnswerEvents, &events, &thread);
+  for (auto _ : state) {
+    events.ping.Signal();
+    events.pong.Wait();
+  }
+  events.stop.store(true, std::memory_order_relaxed);
+  events.ping.Signal();
+  PlatformThread::Join(thread);
+}
+BENCHMARK(BM_WaitableEventRoundTrip)->UseRealTime();
+
+// |turn| is 1 while the answering thread should run.
+struct ConditionVariablePingPong {
+  ConditionVariablePingPong()
+    : turn_changed(&lock)
+    , turn(0)
+    , stop(false) {
+  }
+  Lock lock;
+  ConditionVariable turn_changed;
+  int turn;
+  bool stop;
+};
+
+void AnswerConditionVariable(void* param) {
+  ConditionVariablePingPong* shared = static_cast<ConditionVariablePingPong*>(param);
+  AutoLock locked(shared->lock);
+  for (;;) {
+    while (shared->turn != 1 && !shared->stop)
+      shared->turn_changed.Wait();
+    if (shared->stop)
+      return;
+    shared->turn = 0;
+    shared->turn_changed.Signal();
+  }
+}
+
+void BM_ConditionVariableRoundTrip(benchmark::State& state) {
+  ConditionVariablePingPong shared;
+  PlatformThread::Handle thread;
+  PlatformThread::Create(&AnswerConditionVariable, &shared, &thread);
+  for (auto _ : state) {
+    AutoLock locked(shared.lock);
+    shared.turn = 1;
+    shared.turn_changed.Signal();
+    while (shared.turn != 0)
+      shared.turn_changed.Wait();
+  }
+  {
+    AutoLock locked(shared.lock);
+    shared.stop = true;
+    shared.turn_changed.Signal();
+  }
+  PlatformThread::Join(thread);
+}
+BENCHMARK(BM_ConditionVariableRoundTrip)->UseRealTime();
+
+// The baseline: the same hand-off over the standard library.
+struct StdPingPong {
+  StdPingPong() : turn(0), stop(false) {}
+  std::mutex mutex;
+  std::condition_variable turn_changed;
+  int turn;
+  bool stop;
+};
+
+void AnswerStd(void* param) {
+  StdPingPong* shared = static_cast<StdPingPong*>(param);
+  std::unique_lock<std::mutex> locked(shared->mutex);
+  for (;;) {
+    while (shared->turn != 1 && !shared->stop)
+      shared->turn_changed.wait(locked);
+    if (shared->stop)
+      return;
+    shared->turn = 0;
+    shared->turn_changed.notify_one();
+  }
+}
+
+void BM_StdConditionVariableRoundTrip(benchmark::State& state) {
+  StdPingPong shared;
+  PlatformThread::Handle thread;
+  PlatformThread::Create(&AnswerStd, &shared, &thread);
+  for (auto _ : state) {
+    std::unique_lock<std::mutex> locked(shared.mutex);
+    shared.turn = 1;
+    shared.turn_changed.notify_one();
+    while (shared.turn != 0)
+      shared.turn_changed.wait(locked);
+  }
+  {
+    std::lock_guard<std::mutex> locked(shared.mutex);
+    shared.stop = true;
+    shared.turn_changed.notify_one();
+  }
+  PlatformThread::Join(thread);
+}
+BENCHMARK(BM_StdConditionVariableRoundTrip)->UseRealTime();
+
+}  // namespace
+
+}  // namespace base
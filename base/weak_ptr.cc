@@ -4,23 +4,55 @@
 
 #include "base/weak_ptr.h"
 
+#include <assert.h>
+
 namespace base {
 namespace internal {
 
+#if !defined(NDEBUG)
+namespace {
+
+// Identifies the calling thread by the address of a thread-local.
+thread_local char t_thread_token;
+
+}  // namespace
+#endif
+
 WeakReference::Flag::Flag() : is_valid_(true) {
+#if !defined(NDEBUG)
+  bound_thread_.store(NULL, std::memory_order_relaxed);
+#endif
 }
 
 void WeakReference::Flag::Invalidate() {
-  is_valid_ = false;
+#if !defined(NDEBUG)
+  CheckThread();
+#endif
+  is_valid_.store(false, std::memory_order_release);
 }
 
 bool WeakReference::Flag::IsValid() const {
-  return is_valid_;
+#if !defined(NDEBUG)
+  CheckThread();
+#endif
+  return is_valid_.load(std::memory_order_acquire);
 }
 
 WeakReference::Flag::~Flag() {
 }
 
+#if !defined(NDEBUG)
+void WeakReference::Flag::CheckThread() const {
+  const void* current_thread = &t_thread_token;
+  const void* bound_thread = NULL;
+  if (!bound_thread_.compare_exchange_strong(bound_thread, current_thread,
+                                             std::memory_order_relaxed)) {
+    assert(bound_thread == current_thread &&
+           "WeakPtr used on more than one thread");
+  }
+}
+#endif
+
 WeakReference::WeakReference() {
 }
 
@@ -32,7 +64,7 @@ WeakReference::~WeakReference() {
 
 bool WeakReference::is_valid() const { return flag_.get() && flag_->IsValid(); }
 
-WeakReferenceOwner::WeakReferenceOwner() {
+WeakReferenceOwner::WeakReferenceOwner() : flag_(NULL) {
 }
 
 WeakReferenceOwner::~WeakReferenceOwner() {
@@ -40,17 +72,29 @@ WeakReferenceOwner::~WeakReferenceOwner() {
 }
 
 WeakReference WeakReferenceOwner::GetRef() const {
-  // If we hold the last reference to the Flag then create a new one.
-  if (!HasRefs())
-    flag_ = new WeakReference::Flag();
+  WeakReference::Flag* flag = flag_.load(std::memory_order_acquire);
+  if (!flag) {
+    // Racing threads each make a flag; all but the first to publish theirs
+    // throw it away and use the winner's.
+    WeakReference::Flag* new_flag = new WeakReference::Flag();
+    new_flag->AddRef();
+    if (flag_.compare_exchange_strong(flag, new_flag,
+                                      std::memory_order_acq_rel,
+                                      std::memory_order_acquire)) {
+      flag = new_flag;
+    } else {
+      new_flag->Release();
+    }
+  }
 
-  return WeakReference(flag_.get());
+  return WeakReference(flag);
 }
 
 void WeakReferenceOwner::Invalidate() {
-  if (flag_.get()) {
-    flag_->Invalidate();
-    flag_ = NULL;
+  WeakReference::Flag* flag = flag_.exchange(NULL, std::memory_order_acq_rel);
+  if (flag) {
+    flag->Invalidate();
+    flag->Release();
   }
 }
 
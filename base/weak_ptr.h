@@ -49,13 +49,21 @@
 
 // Weak pointers may be passed safely between threads, but must always be
 // dereferenced and invalidated on the same thread otherwise checking the
-// pointer would be racey.
+// pointer would be racey.  This makes binding a method to a WeakPtr and
+// posting it to the object's own loop a cheap and safe alternative to
+// keeping the object alive with a reference:
 //
-// To ensure correct use, the first time a WeakPtr issued by a WeakPtrFactory
-// is dereferenced, the factory and its WeakPtrs become bound to the calling
-// thread, and cannot be dereferenced or invalidated on any other thread. Bound
-// WeakPtrs can still be handed off to other threads, e.g. to use to post tasks
-// back to object on the bound thread.
+//   MessageLoop::PostTask(MessageLoop::UI,
+//                         base::Bind(&Controller::Refresh, AsWeakPtr()));
+//
+// The validity flag itself is atomic, and WeakPtrs may be created, copied
+// and destroyed on any thread, so handing them around is race free.
+//
+// In debug builds, the first time a WeakPtr is dereferenced, it and every
+// other WeakPtr sharing its flag become bound to the calling thread;
+// dereferencing or invalidating them on any other thread asserts.  Bound
+// WeakPtrs can still be handed off to other threads, e.g. to use to post
+// tasks back to object on the bound thread.
 //
 // Invalidating the factory's WeakPtrs un-binds it from the thread, allowing it
 // to be passed for a different thread to use or delete it.
@@ -63,6 +71,8 @@
 #ifndef BASE_WEAK_PTR_H_
 #define BASE_WEAK_PTR_H_
 
+#include <atomic>
+
 #include "base/ref_counted.h"
 
 namespace base {
@@ -90,7 +100,18 @@ class BASE_EXPORT WeakReference {
 
     ~Flag();
 
-    bool is_valid_;
+#if !defined(NDEBUG)
+    // Binds the flag to the calling thread on first use and asserts on use
+    // from any other.
+    void CheckThread() const;
+
+    mutable std::atomic<const void*> bound_thread_;
+#endif
+
+    // Cleared with release ordering and read with acquire ordering, so a
+    // WeakPtr seen as valid also sees everything written before it was
+    // handed out.
+    std::atomic<bool> is_valid_;
   };
 
   WeakReference();
@@ -108,16 +129,20 @@ class BASE_EXPORT WeakReferenceOwner {
   WeakReferenceOwner();
   ~WeakReferenceOwner();
 
+  // May be called from several threads at once, but not concurrently with
+  // Invalidate().
   WeakReference GetRef() const;
 
   bool HasRefs() const {
-    return flag_.get() && !flag_->HasOneRef();
+    WeakReference::Flag* flag = flag_.load(std::memory_order_acquire);
+    return flag && !flag->HasOneRef();
   }
 
   void Invalidate();
 
  private:
-  mutable scoped_refptr<WeakReference::Flag> flag_;
+  // Created on first use; holds one reference to the flag.
+  mutable std::atomic<WeakReference::Flag*> flag_;
 };
 
 // This class simplifies the implementation of WeakPtr's type conversion
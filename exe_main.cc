@@ -1,14 +1,19 @@
+#if defined(OS_POSIX)
+#include <signal.h>
+#endif
+
 #include "base/closure.h"
 #include "base/message_loop.h"
+#include "base/platform_thread.h"
 #include "main_runner.h"
 // ֵ֧bind
 void Add1() {}
-void Add2(int i) {}
-void Add3(int i, int j) {}
+void Add2(int /* i */) {}
+void Add3(int /* i */, int /* j */) {}
 class AddClass1 : public base::RefCountedThreadSafe<AddClass1> {
 public:
   void Add() {}
-  void Add1(int i) {}
+  void Add1(int /* i */) {}
   void Add2() const {}
   void TestAdd() {
     base::Closure closure = base::Bind(&AddClass1::Add, this);
@@ -16,12 +21,18 @@ public:
     int i = 0;
     closure = base::Bind(&AddClass1::Add1, this, i);
     closure.Run();
+    closure = base::Bind(&AddClass1::Add2, this);
+    closure.Run();
+    base::Callback<void(int)> callback = base::Bind(&AddClass1::Add1, this);
+    callback.Run(i);
+    closure = base::Bind(&AddClass1::Add, base::Unretained(this));
+    closure.Run();
   }
 };
 class AddClass2 : public base::SupportsWeakPtr<AddClass2> {
 public:
   void Add() {}
-  void Add1(int i) {}
+  void Add1(int /* i */) {}
   void Add2() const {}
   void TestAdd() {
     base::Closure closure = base::Bind(&AddClass2::Add, AsWeakPtr());
@@ -29,15 +40,67 @@ public:
     int i = 0;
     closure = base::Bind(&AddClass2::Add1, AsWeakPtr(), i);
     closure.Run();
+    closure = base::Bind(&AddClass2::Add2, AsWeakPtr());
+    closure.Run();
   }
 };
 
-int APIENTRY wWinMain(HINSTANCE instance, HINSTANCE prev, wchar_t*, int) {
-  scoped_ptr<MainRunner> main_runner(MainRunner::Create());
+#if defined(OS_WIN)
+
+BOOL WINAPI OnConsoleCtrl(DWORD /* ctrl_type */) {
+  MainRunner::RequestQuit();
+  return TRUE;
+}
+
+// Pass --headless to run without a window.
+int APIENTRY wWinMain(HINSTANCE instance, HINSTANCE prev, wchar_t* command_line, int) {
+  bool headless = command_line && wcsstr(command_line, L"--headless");
+  scoped_ptr<MainRunner> main_runner(headless ? MainRunner::CreateHeadless() :
+    MainRunner::Create(instance));
+  if (headless)
+    SetConsoleCtrlHandler(&OnConsoleCtrl, TRUE);
+  main_runner->Initilize();
+  main_runner->PreMainMessageLoopRun();
+  main_runner->Run();
+  main_runner->PostMainMessageLoopRun();
+  main_runner->Shutdown();
+  return 0;
+}
+
+#elif defined(OS_POSIX)
+
+namespace {
+  sigset_t g_quit_signals;
+
+  void WaitForQuitSignal(void* /* param */) {
+    int signal_number = 0;
+    sigwait(&g_quit_signals, &signal_number);
+    MainRunner::RequestQuit();
+  }
+}
+
+// Always headless; SIGINT or SIGTERM shuts down cleanly.
+int main() {
+  // Blocked before any thread starts, so that every thread inherits the mask
+  // and only WaitForQuitSignal() sees them.
+  sigemptyset(&g_quit_signals);
+  sigaddset(&g_quit_signals, SIGINT);
+  sigaddset(&g_quit_signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &g_quit_signals, NULL);
+
+  scoped_ptr<MainRunner> main_runner(MainRunner::CreateHeadless());
   main_runner->Initilize();
-  main_runner->PreMainMessageLoopRun(instance);
+  base::PlatformThread::Handle signal_thread;
+  bool has_signal_thread =
+    base::PlatformThread::Create(&WaitForQuitSignal, NULL, &signal_thread);
+  main_runner->PreMainMessageLoopRun();
   main_runner->Run();
   main_runner->PostMainMessageLoopRun();
   main_runner->Shutdown();
+  // Still waiting unless a signal ended the run.
+  if (has_signal_thread)
+    base::PlatformThread::Detach(signal_thread);
   return 0;
-}
\ No newline at end of file
+}
+
+#endif
\ No newline at end of file
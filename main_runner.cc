@@ -1,12 +1,19 @@
 #include "main_runner.h"
 
+#include <stdio.h>
 #include <time.h>
+#include <atomic>
+#include <string>
 
 #include "base/message_loop.h"
 #include "base/closure.h"
+#include "base/hang_watchdog.h"
+#if defined(OS_WIN)
 #include "resource.h"
+#endif
 
 namespace {
+#if defined(OS_WIN)
 #define MAX_LOADSTRING 100
 
   // Global Variables:
@@ -87,7 +94,7 @@ namespace {
   void MaybeShowAboutDialog(const HWND& hWnd) {
     srand((unsigned)time(NULL));
     if (true || rand() % 10 > 5) {
-      MessageLoop::PostDelayedTask(MessageLoop::UI, base::Bind(ShowAboutDialogOnUI, hWnd), 5*1000);
+      MessageLoop::PostDelayedTask(FROM_HERE, MessageLoop::UI, base::Bind(ShowAboutDialogOnUI, hWnd), 5*1000);
     }
   }
   LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
@@ -105,7 +112,7 @@ namespace {
       switch (wmId)
       {
       case IDM_ABOUT:
-        MessageLoop::PostDelayedTask(MessageLoop::IO, base::Bind(&MaybeShowAboutDialog, hWnd), 5*1000);
+        MessageLoop::PostDelayedTask(FROM_HERE, MessageLoop::IO, base::Bind(&MaybeShowAboutDialog, hWnd), 5*1000);
         break;
       case IDM_EXIT:
         DestroyWindow(hWnd);
@@ -120,7 +127,7 @@ namespace {
       EndPaint(hWnd, &ps);
       break;
     case WM_DESTROY:
-      PostQuitMessage(0);
+      MainRunner::RequestQuit();
       break;
     default:
       return DefWindowProc(hWnd, message, wParam, lParam);
@@ -147,39 +154,253 @@ namespace {
     }
     return (INT_PTR)FALSE;
   }
+#endif
+
+  // Upper bound on stopping all secondary loops.
+  const TimeDelta kShutdownTimeoutMs = 3000;
+
+  // Tasks that run longer than this are reported as hangs.
+  const TimeDelta kHangThresholdMs = 2000;
+
+  void Log(const char* message) {
+#if defined(OS_WIN)
+    OutputDebugStringA(message);
+#else
+    fputs(message, stderr);
+#endif
+  }
+
+  // Set by RequestQuit().  Run() does not start the main loop once it is set.
+  std::atomic<bool> g_quit_requested(false);
+  // Whether Run() is in the main loop.  UI thread only.
+  bool g_main_loop_running = false;
+  // The graph PreMainMessageLoopRun() waits on, if any.  UI thread only.
+  base::StartupGraph* g_waiting_startup_graph = NULL;
+
+  // Start-up milestones differ by fractions of a millisecond, so they are
+  // logged to the microsecond.
+  void LogMilestone(const char* name, long long elapsed_ns) {
+    char message[96];
+    snprintf(message, sizeof(message), "%s: %lld.%03lld ms\n", name,
+      elapsed_ns / 1000000, elapsed_ns / 1000 % 1000);
+    Log(message);
+  }
+
+  void QuitMainLoop() {
+    // During startup the wait for the critical steps is stopped instead, so
+    // that a hung step cannot keep the process up; Run() then sees
+    // |g_quit_requested| and returns at once.
+    if (g_main_loop_running)
+      MessageLoop::current()->Quit();
+    else if (g_waiting_startup_graph)
+      g_waiting_startup_graph->StopWaiting();
+  }
+
+  // To the microsecond, like the milestones.
+  void AppendPhase(std::string* message, const char* separator, const char* name,
+    long long elapsed_ns) {
+    char phase[96];
+    snprintf(phase, sizeof(phase), "%s%s %lld.%03lld ms", separator, name,
+      elapsed_ns / 1000000, elapsed_ns / 1000 % 1000);
+    message->append(phase);
+  }
+
+  void LogPhaseTimings(const MainRunner::PhaseTimings& timings) {
+    std::string message;
+    AppendPhase(&message, "Phases: ", "initialize", timings.initialize_ns);
+    AppendPhase(&message, ", ", "pre main loop", timings.pre_main_loop_ns);
+    AppendPhase(&message, " (", "critical steps", timings.critical_steps_ns);
+    AppendPhase(&message, "), ", "main loop", timings.main_loop_ns);
+    AppendPhase(&message, ", ", "shutdown", timings.shutdown_ns);
+    message += '\n';
+    Log(message.c_str());
+  }
+
+  void LogCriticalPath(const base::StartupGraph& graph, long long created_at_ns) {
+    std::vector<base::StartupGraph::StepId> path = graph.CriticalPath();
+    for (size_t i = 0; i < path.size(); ++i) {
+      base::StartupGraph::StepTiming timing = graph.step_timing(path[i]);
+      char message[160];
+      snprintf(message, sizeof(message),
+        "Startup critical path #%u: %s on loop %d, %lld ms, started at %lld ms\n",
+        static_cast<unsigned>(i), graph.step_name(path[i]),
+        static_cast<int>(graph.step_loop(path[i])),
+        (timing.end_ns - timing.start_ns) / 1000000,
+        (timing.start_ns - created_at_ns) / 1000000);
+      Log(message);
+    }
+  }
+
+  void LogShutdownStats(MessageLoop::ID id, const MessageLoop::ShutdownStats& stats) {
+    char message[160];
+    if (stats.abandoned) {
+      snprintf(message, sizeof(message), "Shutdown of loop %d: gave up after %lld ms\n",
+        static_cast<int>(id), stats.shutdown_ns / 1000000);
+    } else {
+      snprintf(message, sizeof(message),
+        "Shutdown of loop %d: %lld ms, drain %lld ms, %u tasks run, %u skipped, %u purged\n",
+        static_cast<int>(id), stats.shutdown_ns / 1000000, stats.drain_ns / 1000000,
+        static_cast<unsigned>(stats.tasks_run), static_cast<unsigned>(stats.tasks_skipped),
+        static_cast<unsigned>(stats.tasks_purged));
+    }
+    Log(message);
+    if (stats.abandoned)
+      return;
+    snprintf(message, sizeof(message),
+      "Loop %d: %lld tasks posted, %lld run, queue depth p50 %llu, p99 %llu, max %llu\n",
+      static_cast<int>(id), stats.total_tasks_posted, stats.total_tasks_run,
+      static_cast<unsigned long long>(stats.queue_depth.Percentile(50)),
+      static_cast<unsigned long long>(stats.queue_depth.Percentile(99)),
+      static_cast<unsigned long long>(stats.queue_depth.Max()));
+    Log(message);
+  }
+
+  void LogHangReports() {
+    std::vector<base::HangReport> reports = base::HangWatchdog::GetReports();
+    for (size_t i = 0; i < reports.size(); ++i) {
+      const base::HangReport& report = reports[i];
+      char message[256];
+      snprintf(message, sizeof(message), "Hang on loop %s: %lld ms in task posted from %s\n",
+        report.thread_name, report.hung_ms, report.posted_from.ToString().c_str());
+      Log(message);
+      for (size_t frame = 0; frame < report.frame_count; ++frame) {
+        snprintf(message, sizeof(message), "  #%u %p\n", static_cast<unsigned>(frame),
+          report.frames[frame]);
+        Log(message);
+      }
+    }
+  }
+}
+
+MainRunner::PhaseTimings::PhaseTimings()
+  : initialize_ns(0)
+  , pre_main_loop_ns(0)
+  , critical_steps_ns(0)
+  , main_loop_ns(0)
+  , shutdown_ns(0) {
 }
 
-MainRunner* MainRunner::Create() {
-  return new MainRunner();
+#if defined(OS_WIN)
+MainRunner* MainRunner::Create(HINSTANCE instance) {
+  MainRunner* runner = new MainRunner(false);
+  runner->instance_ = instance;
+  return runner;
 }
+#endif
 
-MainRunner::MainRunner() {
+MainRunner* MainRunner::CreateHeadless() {
+  return new MainRunner(true);
+}
+
+MainRunner::MainRunner(bool headless)
+  : headless_(headless)
+#if defined(OS_WIN)
+  , instance_(NULL)
+#endif
+  , created_at_ns_(base::MonotonicNanoseconds())
+  , startup_graph_(new base::StartupGraph) {
+  // A quit requested of an earlier runner does not carry over.
+  g_quit_requested.store(false, std::memory_order_relaxed);
 }
 
 MainRunner::~MainRunner() {}
 
 void MainRunner::Initilize() {
+  long long phase_start = base::MonotonicNanoseconds();
+  // Secondary threads come up on first use instead of delaying the window.
   for (size_t id = MessageLoop::UI + 1; id < MessageLoop::ID_COUNT; ++id) {
-    MessageLoop::Start(static_cast<MessageLoop::ID>(id));
+    MessageLoop::StartLazily(static_cast<MessageLoop::ID>(id));
   }
-  main_message_loop_.reset(new MessageLoop(MessageLoop::UI));
+  main_message_loop_.reset(new MessageLoop(MessageLoop::UI,
+    headless_ ? MessageLoop::TYPE_DEFAULT : MessageLoop::TYPE_UI));
+  base::HangWatchdog::Start(kHangThresholdMs);
+  // Steps on other loops start while the window is being created.
+  startup_graph_->Start();
+  phase_timings_.initialize_ns = base::MonotonicNanoseconds() - phase_start;
 }
 
-void MainRunner::PreMainMessageLoopRun(HINSTANCE instance) {
-  MyRegisterClass(instance);
-  InitInstance (instance, SW_SHOW);
+void MainRunner::PreMainMessageLoopRun() {
+  long long phase_start = base::MonotonicNanoseconds();
+#if defined(OS_WIN)
+  if (!headless_) {
+    MyRegisterClass(instance_);
+    InitInstance (instance_, SW_SHOW);
+
+    LogMilestone("Time to first window",
+      base::MonotonicNanoseconds() - created_at_ns_);
+  }
+#endif
+
+  // UI steps run here too, with the window already up.  A quit requested
+  // before the wait found nothing to stop, so it is stopped here.
+  long long wait_start = base::MonotonicNanoseconds();
+  g_waiting_startup_graph = startup_graph_.get();
+  if (g_quit_requested.load(std::memory_order_acquire))
+    startup_graph_->StopWaiting();
+  bool ready = startup_graph_->RunUntilCriticalStepsDone();
+  g_waiting_startup_graph = NULL;
+  phase_timings_.critical_steps_ns = base::MonotonicNanoseconds() - wait_start;
+  phase_timings_.pre_main_loop_ns = base::MonotonicNanoseconds() - phase_start;
+
+  if (!ready) {
+    Log("Quit before the critical startup steps finished\n");
+    return;
+  }
+  LogMilestone("Time to ready", base::MonotonicNanoseconds() - created_at_ns_);
+  LogCriticalPath(*startup_graph_, created_at_ns_);
 }
 
 void MainRunner::Run() {
-  main_message_loop_->Run();
+  long long phase_start = base::MonotonicNanoseconds();
+  if (!g_quit_requested.load(std::memory_order_acquire)) {
+    g_main_loop_running = true;
+    main_message_loop_->Run();
+    g_main_loop_running = false;
+  }
+  phase_timings_.main_loop_ns = base::MonotonicNanoseconds() - phase_start;
 }
 
 void MainRunner::PostMainMessageLoopRun() {
-
 }
 
 void MainRunner::Shutdown() {
+  long long phase_start = base::MonotonicNanoseconds();
+  // The process exits right after this, so tasks that will never run are not
+  // worth destroying.
+  MessageLoop::SetFastShutdown(true);
+  long long deadline = base::MonotonicNanoseconds() + kShutdownTimeoutMs * 1000000LL;
   for (size_t id = MessageLoop::ID_COUNT - 1; id >= MessageLoop::UI + 1; --id) {
-    MessageLoop::Stop(static_cast<MessageLoop::ID>(id));
+    long long remaining_ns = deadline - base::MonotonicNanoseconds();
+    TimeDelta remaining_ms = remaining_ns > 0 ? static_cast<TimeDelta>(remaining_ns / 1000000) : 0;
+    MessageLoop::ShutdownStats stats;
+    MessageLoop::Stop(static_cast<MessageLoop::ID>(id), remaining_ms, &stats);
+    LogShutdownStats(static_cast<MessageLoop::ID>(id), stats);
   }
+
+  // Secondary loops may have posted work that must still run on this thread.
+  MessageLoop::ShutdownStats stats;
+  long long drain_start = base::MonotonicNanoseconds();
+  main_message_loop_->DrainForShutdown(&stats);
+  stats.shutdown_ns = base::MonotonicNanoseconds() - drain_start;
+  LogShutdownStats(MessageLoop::UI, stats);
+
+  base::HangWatchdog::Stop();
+  LogHangReports();
+
+#if !defined(NDEBUG)
+  char message[64];
+  snprintf(message, sizeof(message), "Reference count operations: %lld\n",
+    base::subtle::RefCountedThreadSafeBase::atomic_op_count());
+  Log(message);
+#endif
+  phase_timings_.shutdown_ns = base::MonotonicNanoseconds() - phase_start;
+  LogPhaseTimings(phase_timings_);
+}
+
+// static
+void MainRunner::RequestQuit() {
+  // Set before posting, so a task that finds the main loop not yet running
+  // leaves the flag for Run().
+  g_quit_requested.store(true, std::memory_order_release);
+  MessageLoop::PostTask(FROM_HERE, MessageLoop::UI, base::Bind(&QuitMainLoop));
 }
\ No newline at end of file
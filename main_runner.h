@@ -2,19 +2,53 @@
 #define MAIN_RUNNER_H_
 
 #include "base/message_loop.h"
+#include "base/startup_graph.h"
 
 class MainRunner {
 public:
-  static MainRunner* Create();
-  MainRunner();
+  // How long each phase took, in nanoseconds; 0 until it has run.
+  struct PhaseTimings {
+    PhaseTimings();
+
+    long long initialize_ns;
+    long long pre_main_loop_ns;
+    // The part of pre_main_loop_ns spent waiting for critical startup steps.
+    long long critical_steps_ns;
+    long long main_loop_ns;
+    long long shutdown_ns;
+  };
+
+#if defined(OS_WIN)
+  static MainRunner* Create(HINSTANCE instance);
+#endif
+  // No window: the UI loop runs tasks only and Run() returns on
+  // RequestQuit(), so the process can run as a daemon.
+  static MainRunner* CreateHeadless();
   ~MainRunner();
   void Initilize();
-  void PreMainMessageLoopRun(HINSTANCE instance);
+  void PreMainMessageLoopRun();
   void Run();
   void PostMainMessageLoopRun();
   void Shutdown();
+  // Makes Run() return, or return at once if it has not started yet.  Also
+  // ends PreMainMessageLoopRun()'s wait for critical startup steps.  May be
+  // called on any thread.
+  static void RequestQuit();
+  // Components add their initialization steps here before Initilize().
+  base::StartupGraph* startup_graph() { return startup_graph_.get(); }
+  bool headless() const { return headless_; }
+  const PhaseTimings& phase_timings() const { return phase_timings_; }
 private:
+  explicit MainRunner(bool headless);
+
   scoped_ptr<MessageLoop> main_message_loop_;
+  bool headless_;
+#if defined(OS_WIN)
+  HINSTANCE instance_;
+#endif
+  long long created_at_ns_;
+  PhaseTimings phase_timings_;
+  scoped_refptr<base::StartupGraph> startup_graph_;
   DISALLOW_COPY_AND_ASSIGN(MainRunner);
 };
 #endif
\ No newline at end of file
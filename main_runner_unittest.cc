@@ -0,0 +1,72 @@
+#include "main_runner.h"
+
+#include "base/closure.h"
+#include "base/platform_thread.h"
+#include "base/waitable_event.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+void RequestQuitWhenSignaled(void* param) {
+  base::WaitableEvent* signaled = static_cast<base::WaitableEvent*>(param);
+  EXPECT_TRUE(signaled->TimedWait(5000));
+  MainRunner::RequestQuit();
+}
+
+void HangUntilReleased(base::WaitableEvent* started,
+  base::WaitableEvent* release) {
+  started->Signal();
+  EXPECT_TRUE(release->TimedWait(5000));
+}
+
+// The phases exe_main.cc runs after Initilize().
+void RunToCompletion(MainRunner* main_runner) {
+  main_runner->PreMainMessageLoopRun();
+  main_runner->Run();
+  main_runner->PostMainMessageLoopRun();
+  main_runner->Shutdown();
+}
+
+}  // namespace
+
+TEST(MainRunnerTest, QuitBeforeRunReturnsAtOnce) {
+  scoped_ptr<MainRunner> main_runner(MainRunner::CreateHeadless());
+  main_runner->Initilize();
+  MainRunner::RequestQuit();
+  RunToCompletion(main_runner.get());
+}
+
+TEST(MainRunnerTest, QuitFromAnotherThreadDuringRunReturns) {
+  scoped_ptr<MainRunner> main_runner(MainRunner::CreateHeadless());
+  main_runner->Initilize();
+  base::WaitableEvent running(true, false);
+  base::PlatformThread::Handle thread;
+  ASSERT_TRUE(base::PlatformThread::Create(&RequestQuitWhenSignaled, &running,
+    &thread));
+  // Runs once the main loop has started, there being no critical steps.
+  MessageLoop::PostTask(MessageLoop::UI,
+    base::Bind(&base::WaitableEvent::Signal, base::Unretained(&running)));
+  RunToCompletion(main_runner.get());
+  base::PlatformThread::Join(thread);
+  EXPECT_GT(main_runner->phase_timings().main_loop_ns, 0);
+}
+
+TEST(MainRunnerTest, QuitDuringHungCriticalStepReturns) {
+  scoped_ptr<MainRunner> main_runner(MainRunner::CreateHeadless());
+  base::WaitableEvent step_started(true, false);
+  base::WaitableEvent release(true, false);
+  main_runner->startup_graph()->AddStep("hung", MessageLoop::IO,
+    base::Bind(&HangUntilReleased, &step_started, &release),
+    base::StartupGraph::CRITICAL);
+  main_runner->Initilize();
+  base::PlatformThread::Handle thread;
+  ASSERT_TRUE(base::PlatformThread::Create(&RequestQuitWhenSignaled,
+    &step_started, &thread));
+  main_runner->PreMainMessageLoopRun();
+  main_runner->Run();
+  main_runner->PostMainMessageLoopRun();
+  // Lets Shutdown() join the IO thread instead of abandoning it.
+  release.Signal();
+  main_runner->Shutdown();
+  base::PlatformThread::Join(thread);
+}
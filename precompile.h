@@ -5,33 +5,51 @@
 
 #pragma once
 
+#if defined(_WIN32)
+#define OS_WIN 1
+#elif defined(__linux__)
+#define OS_LINUX 1
+#define OS_POSIX 1
+#endif
+
+#if defined(OS_WIN)
 #include <SDKDDKVer.h>
 
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
 // Windows Header Files:
 #include <windows.h>
+#endif
 
 #define BASE_EXPORT /*__declspec(dllexport)*/
 
-#define DISALLOW_COPY_AND_ASSIGN(TypeName) \
-  TypeName(const TypeName&);               \
+// Thread storage for trivially constructed, zero-initialized variables.
+// Unlike thread_local, no first-use initialization check is emitted when the
+// variable is used from another translation unit.
+#if defined(_MSC_VER)
+#define BASE_THREAD_LOCAL_POD __declspec(thread)
+#else
+#define BASE_THREAD_LOCAL_POD __thread
+#endif
+
+#define DISALLOW_COPY_AND_ASSIGN(TypeName) \
+  TypeName(const TypeName&);               \
   void operator=(const TypeName&)
 
-#define MOVE_ONLY_TYPE_FOR_CPP_03(type, rvalue_type) \
- private: \
-struct rvalue_type { \
-  explicit rvalue_type(type* object) : object(object) {} \
-  type* object; \
-}; \
-  type(type&); \
-  void operator=(type&); \
- public: \
- operator rvalue_type() { return rvalue_type(this); } \
- type Pass() { return type(rvalue_type(this)); } \
+#define MOVE_ONLY_TYPE_FOR_CPP_03(type, rvalue_type) \
+ private: \
+struct rvalue_type { \
+  explicit rvalue_type(type* object) : object(object) {} \
+  type* object; \
+}; \
+  type(type&); \
+  void operator=(type&); \
+ public: \
+ operator rvalue_type() { return rvalue_type(this); } \
+ type Pass() { return type(rvalue_type(this)); } \
  private:
 
-#define DISALLOW_IMPLICIT_CONSTRUCTORS(TypeName) \
-  TypeName();                                    \
+#define DISALLOW_IMPLICIT_CONSTRUCTORS(TypeName) \
+  TypeName();                                    \
   DISALLOW_COPY_AND_ASSIGN(TypeName)
 
 // TODO: reference additional headers your program requires here